@@ -0,0 +1,100 @@
+#ifndef CHUNK_CACHE
+#define CHUNK_CACHE
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frameArena.hpp"
+#include "meshChunks.hpp"
+#include "reprojection.hpp"
+#include "screenRender.hpp"
+
+// Keeps the chunks of a .chunks file that the camera can see in memory,
+// within a memory cap. Missing chunks are read on a background thread, so
+// a frame draws whatever is resident and new chunks appear as they arrive.
+// Chunks the camera is moving towards are prefetched, and the least
+// recently visible chunks are evicted when over the cap. A chunk that
+// cannot be read is not requested again.
+class ChunkCache {
+    private:
+    enum class chunkState { unloaded, queued, resident, failed };
+
+    struct loadedChunk {
+        size_t index;
+        std::vector<worldTriangle> triangles;
+    };
+
+    std::vector<chunkInfo> chunks;
+    std::vector<chunkState> states;
+    std::vector<std::vector<worldTriangle>> triangles; // Resident chunk data
+    std::vector<unsigned long long> lastUsedFrame; // Last frame each chunk was visible or prefetched
+    std::vector<unsigned long long> lastDrawnFrame;
+    std::vector<size_t> visible; // Chunks visible this frame, nearest first
+    std::vector<size_t> newlyVisible; // Visible chunks that became resident this frame
+    std::vector<loadedChunk> arrived;
+    size_t memoryCap;
+    size_t residentBytes;
+    size_t queuedBytes;
+    unsigned long long frame;
+    bool canEvict; // False once nothing is left to evict this frame
+    point4D lastCameraPos;
+    bool open;
+
+    // Shared with the loader thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<size_t> requests; // Visible chunks, loaded before prefetches
+    std::deque<size_t> prefetchRequests;
+    std::vector<loadedChunk> completed;
+    bool stopping;
+    std::thread loader;
+    std::string path;
+
+    public:
+    // Open filename.chunks, keeping at most memoryCap bytes of triangles resident
+    ChunkCache(std::string filename, size_t _memoryCap);
+    ~ChunkCache();
+    ChunkCache(const ChunkCache&) = delete;
+    ChunkCache& operator=(const ChunkCache&) = delete;
+
+    bool isOpen() const {return open;}
+    size_t getResidentBytes() const {return residentBytes;}
+    size_t getChunkCount() const {return chunks.size();}
+    const chunkInfo& getChunk(size_t chunk) const {return chunks[chunk];}
+    // Chunks found visible by the last update() that were not drawn the frame before
+    const std::vector<size_t>& getNewlyVisible() const {return newlyVisible;}
+
+    // Find the chunks visible with combinedM, queue loads for missing ones and
+    // for chunks ahead of the camera's motion, and evict to stay under the cap.
+    // Call once per frame before drawing.
+    void update(Camera &camera, const std::array<float, 16> &combinedM);
+
+    // Draw the resident chunks found visible by the last update(). With a
+    // reprojector, only into its redrawn tiles, skipping chunks outside them.
+    void draw(Camera &camera, const std::array<float, 16> &combinedM, size_t width, size_t height,
+              AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena,
+              const Reprojector* reprojector = nullptr);
+
+    private:
+    void _loaderLoop();
+    void _collectCompleted();
+    // Queue a load for chunk if it fits under the cap, evicting chunks not
+    // visible this frame to make room. Returns false if it does not fit, a
+    // smaller chunk may still fit.
+    bool _request(size_t chunk, bool urgent);
+    bool _evictOne();
+};
+
+// Render a frame from a chunk cache, streaming in chunks as needed. With a
+// reprojector, earlier frames are reused and chunks that arrive are redrawn
+// where they appear.
+void renderStreamed(Camera &camera, ChunkCache &cache, size_t width, size_t height,
+                    AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena,
+                    Reprojector* reprojector = nullptr);
+
+#endif
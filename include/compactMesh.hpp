@@ -0,0 +1,56 @@
+#ifndef COMPACT_MESH
+#define COMPACT_MESH
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "frameArena.hpp"
+#include "screenRender.hpp"
+
+// Compact encoding of a triangle list, 22 bytes per triangle instead of the
+// 64 of worldTriangle, so less memory is streamed through per frame.
+// Positions are quantized to 16 bits per axis within the mesh's bounding
+// box, and face colours are worked out once when encoding. No normal is
+// stored, backface culling uses the normal of the decoded triangle.
+// Positions are decoded by the vertex transform, which takes the quantized
+// values with the dequantization folded into its matrix.
+struct compactTriangle {
+    uint16_t position[9]; // A, B, C x y z, counterclockwise
+    uint16_t color[2]; // Face colour, low half first. A colorARGB would pad the struct to 24 bytes.
+
+    colorARGB getColor() const {return color[0] | (static_cast<colorARGB> (color[1]) << 16);}
+};
+static_assert(sizeof(compactTriangle) == 22, "compactTriangle should have no padding");
+
+struct compactMesh {
+    float origin[3]; // World position of quantized coordinate 0
+    float step[3]; // World size of one quantization step along each axis
+    std::vector<compactTriangle> triangles;
+};
+
+// How far a compact mesh can be from the triangles it was built from
+struct compactError {
+    float positionBound; // Largest distance any vertex can move, from the quantization step
+    float positionMeasured; // Largest distance a vertex actually moved
+    float normalDegrees; // Largest angle between the normal of a decoded triangle and the original
+};
+
+// Encode triangles, replacing the contents of mesh
+void buildCompactMesh(const std::vector<worldTriangle> &triangles, compactMesh &mesh);
+// World position of one of a compact triangle's vertices, 0 to 2 for A to C
+point4D decodePosition(const compactMesh &mesh, const compactTriangle &triangle, int vertex);
+// Compare mesh against the triangles it was built from, which must be unchanged
+compactError measureCompactError(const std::vector<worldTriangle> &triangles, const compactMesh &mesh);
+// Largest on screen movement in pixels, to first order, that the position
+// error can cause for geometry at view depth depth in a width x height image
+float screenErrorBound(const compactError &error, const Camera &camera, size_t width, size_t height, float depth);
+
+// Rasterize a compact mesh, the same as drawTriangles
+void drawCompactTriangles(Camera &camera, const compactMesh &mesh, const std::array<float, 16> &combinedM,
+                          size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer,
+                          drawBatch &batch, const uint8_t* dirtyTiles = nullptr);
+// Load the rendered frame into imageArr, the same as renderImage
+void renderCompactImage(Camera &camera, const compactMesh &mesh, size_t width, size_t height,
+                        AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena);
+
+#endif
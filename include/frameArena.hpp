@@ -0,0 +1,108 @@
+#ifndef FRAME_ARENA
+#define FRAME_ARENA
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Alignment used for framebuffers and arena arrays, one cache line
+constexpr size_t FRAME_ALIGNMENT = 64;
+
+// Allocate and free memory aligned to a power of two boundary
+void* alignedAlloc(size_t bytes, size_t alignment);
+void alignedFree(void* ptr);
+
+// Counts every allocation made through the global operator new or
+// alignedAlloc, so arena growth and AlignedBuffer growth are included. Call
+// beginFrame() at the start of a frame, and frameAllocations() after it
+// to get the number of heap allocations made during that frame.
+namespace allocStats {
+    void beginFrame();
+    size_t frameAllocations();
+    size_t totalAllocations();
+}
+
+// Linear allocator for transient per-frame data. Memory handed out is only
+// valid until the next reset(). If a frame needs more than the current
+// capacity, extra blocks are allocated for that frame, and the arena grows
+// to the high-water mark on the next reset() so later frames never touch
+// the heap.
+class FrameArena {
+    private:
+    char* block;
+    size_t capacity;
+    size_t offset;
+    size_t frameBytes; // Bytes requested this frame, including overflow
+    size_t highWater;
+    std::vector<char*> overflowBlocks;
+    public:
+    explicit FrameArena(size_t initialCapacity = 1 << 20);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Returns uninitialized memory aligned to alignment (at most
+    // FRAME_ALIGNMENT), never nullptr
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // Returns an uninitialized, cache line aligned array of count elements
+    template<typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*> (allocate(count * sizeof(T), FRAME_ALIGNMENT));
+    }
+
+    // Release everything allocated this frame, must be called once per frame
+    void reset();
+
+    size_t getCapacity() const {return capacity;}
+    size_t getUsed() const {return frameBytes;}
+    size_t getHighWater() const {return highWater;}
+};
+
+// Cache line aligned storage that keeps its memory across resizes. Resizing
+// only reallocates when growing past the largest size seen so far, so window
+// resizes reuse the same block. Contents are not preserved on growth.
+template<typename T>
+class AlignedBuffer {
+    private:
+    T* buffer;
+    size_t count;
+    size_t capacity;
+    public:
+    AlignedBuffer() : buffer(nullptr), count(0), capacity(0) {}
+    explicit AlignedBuffer(size_t _count) : AlignedBuffer() {resize(_count);}
+    ~AlignedBuffer() {alignedFree(buffer);}
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+    AlignedBuffer(AlignedBuffer &&other) noexcept :
+        buffer(std::exchange(other.buffer, nullptr)),
+        count(std::exchange(other.count, 0)),
+        capacity(std::exchange(other.capacity, 0)) {}
+    AlignedBuffer& operator=(AlignedBuffer &&other) noexcept {
+        std::swap(buffer, other.buffer);
+        std::swap(count, other.count);
+        std::swap(capacity, other.capacity);
+        return *this;
+    }
+
+    void resize(size_t _count) {
+        if(_count > capacity) {
+            alignedFree(buffer);
+            buffer = static_cast<T*> (alignedAlloc(_count * sizeof(T), FRAME_ALIGNMENT));
+            capacity = _count;
+        }
+        count = _count;
+    }
+
+    T* data() {return buffer;}
+    const T* data() const {return buffer;}
+    size_t size() const {return count;}
+    T* begin() {return buffer;}
+    T* end() {return buffer + count;}
+    T& operator[](size_t i) {return buffer[i];}
+    const T& operator[](size_t i) const {return buffer[i];}
+};
+
+#endif
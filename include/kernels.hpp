@@ -0,0 +1,78 @@
+#ifndef KERNELS
+#define KERNELS
+
+#include <cstddef>
+#include <cstdint>
+
+// Outcode bits, set for each clip plane a vertex lies outside of
+enum clipOutcode : uint8_t {
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5
+};
+
+// Screen space triangle values needed to rasterize one span. Vertex A's
+// position, the depth of all three vertices, and the edge vectors AB (v0)
+// and AC (v1) used to solve barycentric coordinates.
+struct spanSetup {
+    float ax, ay, az, bz, cz;
+    float v0x, v0y, v1x, v1y;
+    float detInverse;
+};
+
+// Instruction sets the hot kernels are compiled for, narrowest first
+enum class kernelIsa { scalar, sse41, avx2, avx512 };
+
+// Hot render kernels for one instruction set. Every variant gives results
+// identical to the scalar one.
+struct renderKernels {
+    kernelIsa isa;
+    const char* name;
+
+    // Transform count world space vertices, given as separate x, y and z
+    // arrays with w = 1, to screen space with a row major 4x4 matrix.
+    // Perspective divide and viewport mapping are done in the same pass,
+    // and outcode receives the clip planes each vertex is outside of.
+    void (*transformVertices)(const float* matrix, const float* inX, const float* inY, const float* inZ,
+                              size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                              float* outX, float* outY, float* outZ, uint8_t* outcode);
+
+    // Rasterize pixels xBegin to xEnd inclusive of row y, writing color and
+    // depth where the pixel centre is inside the triangle and passes the
+    // depth test. colorRow and depthRow point to the start of row y.
+    void (*rasterSpan)(const spanSetup &tri, int y, int xBegin, int xEnd, uint32_t color,
+                       uint32_t* colorRow, float* depthRow);
+
+    // Fill count pixels of the color and depth buffers
+    void (*clearFrame)(uint32_t* color, float* depth, size_t count, uint32_t clearColor, float clearDepth);
+
+    // Copy a width x height image into a destination with a row stride in bytes
+    void (*copyFrame)(uint8_t* dst, ptrdiff_t dstStride, const uint32_t* src, size_t width, size_t height);
+};
+
+extern const renderKernels scalarKernels;
+extern const renderKernels sse41Kernels;
+extern const renderKernels avx2Kernels;
+extern const renderKernels avx512Kernels;
+
+// Kernels for the selected instruction set. On first use this is the widest
+// set the CPU supports, unless the RENDERER_KERNELS environment variable
+// names another (scalar, sse41, avx2 or avx512).
+const renderKernels& getKernels();
+
+// Select the kernels for isa, returns false and keeps the current selection
+// if the CPU does not support it
+bool forceKernelIsa(kernelIsa isa);
+
+bool isaSupported(kernelIsa isa);
+kernelIsa bestSupportedIsa();
+const renderKernels& kernelsForIsa(kernelIsa isa);
+
+// Parse an instruction set name as used by RENDERER_KERNELS, returns false
+// if the name is not recognised
+bool parseKernelIsa(const char* name, kernelIsa &isa);
+
+#endif
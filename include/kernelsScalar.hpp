@@ -0,0 +1,70 @@
+#ifndef KERNELS_SCALAR
+#define KERNELS_SCALAR
+
+#include "kernels.hpp"
+
+// Scalar kernel bodies, included by every kernel source so the SIMD
+// variants can finish leftover elements with them. They are static so each
+// source gets its own copy built with its own instruction set flags, as a
+// shared inline copy could be built with instructions the CPU lacks.
+
+// Transform one vertex, the operation order here defines the results the
+// SIMD variants must reproduce
+static inline void scalarTransformVertex(const float* A, float x, float y, float z,
+                                         float nearPlaneDist, float farPlaneDist, float width, float height,
+                                         float &outX, float &outY, float &outZ, uint8_t &outcode) {
+    float clipX = A[0] * x + A[1] * y + A[2] * z + A[3];
+    float clipY = A[4] * x + A[5] * y + A[6] * z + A[7];
+    float clipZ = A[8] * x + A[9] * y + A[10] * z + A[11];
+    float clipW = A[12] * x + A[13] * y + A[14] * z + A[15];
+
+    outcode = (clipX < -clipW ? CLIP_LEFT : 0) | (clipX > clipW ? CLIP_RIGHT : 0) |
+              (clipY < -clipW ? CLIP_BOTTOM : 0) | (clipY > clipW ? CLIP_TOP : 0) |
+              (clipZ < -nearPlaneDist ? CLIP_NEAR : 0) | (clipZ > farPlaneDist ? CLIP_FAR : 0);
+
+    outX = width - (clipX / clipW + 1.0f) * width * 0.5f; // Perspective divide and viewport mapping
+    outY = height - (clipY / clipW + 1.0f) * height * 0.5f;
+    outZ = clipZ / clipW;
+}
+
+static inline void scalarTransformVertices(const float* A, const float* inX, const float* inY, const float* inZ,
+                                           size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                                           float* outX, float* outY, float* outZ, uint8_t* outcode) {
+    for(size_t i = 0; i < count; i++) {
+        scalarTransformVertex(A, inX[i], inY[i], inZ[i], nearPlaneDist, farPlaneDist, width, height,
+                              outX[i], outY[i], outZ[i], outcode[i]);
+    }
+}
+
+// Barycentric coordinates of the pixel centre are solved relative to vertex
+// A, and the pixel is written if all three are positive and it is closer
+// than the depth buffer
+static inline void scalarRasterSpan(const spanSetup &tri, int y, int xBegin, int xEnd, uint32_t color,
+                                    uint32_t* colorRow, float* depthRow) {
+    float v2y = (y + 0.5f) - tri.ay;
+    for(int x = xBegin; x <= xEnd; x++) {
+        float v2x = (x + 0.5f) - tri.ax;
+        float v = tri.detInverse * (tri.v1y * v2x - tri.v1x * v2y);
+        float w = tri.detInverse * (-tri.v0y * v2x + tri.v0x * v2y);
+        float u = 1 - v - w;
+        float depth = u * tri.az + v * tri.bz + w * tri.cz;
+
+        if(u > 0 && v > 0 && w > 0 && depth < depthRow[x]) {
+            colorRow[x] = color;
+            depthRow[x] = depth;
+        }
+    }
+}
+
+static inline void scalarClearFrame(uint32_t* color, float* depth, size_t count, uint32_t clearColor, float clearDepth) {
+    for(size_t i = 0; i < count; i++) {
+        color[i] = clearColor;
+        depth[i] = clearDepth;
+    }
+}
+
+static inline void scalarCopyRow(uint32_t* dst, const uint32_t* src, size_t count) {
+    for(size_t i = 0; i < count; i++) dst[i] = src[i];
+}
+
+#endif
@@ -2,17 +2,95 @@
 #define MATRICES
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include "kernels.hpp"
 #include "screenRender.hpp"
 
 // Multiply two nxn matricies, returns the combined nxn matrix
-std::array<float, 16> matrixMultiply(const std::array<float, 16> &A, const std::array<float, 16> &B);
+constexpr std::array<float, 16> matrixMultiply(const std::array<float, 16> &A, const std::array<float, 16> &B) {
+    std::array<float, 16> C {};
+    for(size_t row = 0; row < 4; row++) {
+        for(size_t col = 0; col < 4; col++) {
+            float sum = 0.0f;
+            for(size_t p = 0; p < 4; p++) {
+                sum += A[p + 4 * row] * B[col + 4 * p];
+            }
+            C[col + 4 * row] = sum;
+        }
+    }
+    return C;
+}
 
 // Multiply an nxn matrix by an nx1 vector, returns nx1 vector
-point4D matrixVectorMultiply(const std::array<float, 16> &A, point4D V);
+constexpr point4D matrixVectorMultiply(const std::array<float, 16> &A, point4D V) {
+    point4D _V;
+    _V.x = A[0] * V.x + A[1] * V.y + A[2] * V.z + A[3] * V.w;
+    _V.y = A[4] * V.x + A[5] * V.y + A[6] * V.z + A[7] * V.w;
+    _V.z = A[8] * V.x + A[9] * V.y + A[10] * V.z + A[11] * V.w;
+    _V.w = A[12] * V.x + A[13] * V.y + A[14] * V.z + A[15] * V.w;
+    return _V;
+}
+
+// Matrix builders taking plain values, usable at compile time. The camera
+// versions below fill them in from the camera's current state.
+
+// Translate by (x, y, z)
+constexpr std::array<float, 16> translationMatrix(float x, float y, float z) {
+    return {1, 0, 0, x,
+            0, 1, 0, y,
+            0, 0, 1, z,
+            0, 0, 0, 1};
+}
+
+// Scale by (x, y, z) along each axis
+constexpr std::array<float, 16> scaleMatrix(float x, float y, float z) {
+    return {x, 0, 0, 0,
+            0, y, 0, 0,
+            0, 0, z, 0,
+            0, 0, 0, 1};
+}
+
+// Rotate about the y axis, given the sine and cosine of the yaw angle
+constexpr std::array<float, 16> yawMatrix(float sinYaw, float cosYaw) {
+    return {cosYaw, 0, -sinYaw, 0,
+            0,      1, 0,       0,
+            sinYaw, 0, cosYaw,  0,
+            0,      0, 0,       1};
+}
+
+// Rotate about the x axis, given the sine and cosine of the pitch angle
+constexpr std::array<float, 16> pitchMatrix(float sinPitch, float cosPitch) {
+    return {1, 0,        0,         0,
+            0, cosPitch, -sinPitch, 0,
+            0, sinPitch, cosPitch,  0,
+            0, 0,        0,         1};
+}
+
+// Perspective projection, tanHalfFov is tan(fov / 2)
+constexpr std::array<float, 16> perspectiveMatrix(float tanHalfFov, float aspectRatio,
+                                                  float nearPlaneDist, float farPlaneDist) {
+    float depthRange = farPlaneDist - nearPlaneDist;
+    return {1 / tanHalfFov, 0, 0, 0,
+            0, aspectRatio / tanHalfFov, 0, 0,
+            0, 0, (farPlaneDist + nearPlaneDist) / depthRange, -2 * farPlaneDist * nearPlaneDist / depthRange,
+            0, 0, 1, 0};
+}
+
+// Invert a 4x4 matrix, returns false and leaves inverse unchanged if A is singular
+bool matrixInverse(const std::array<float, 16> &A, std::array<float, 16> &inverse);
 
 void cameraToOrigin(Camera &camera, std::array<float, 16> &A);
 void cameraRotateYaw(Camera &camera, std::array<float, 16> &A);
 void cameraRotatePitch(Camera &camera, std::array<float, 16> &A);
 void cameraToClipSpace(Camera &camera, float aspectRatio, std::array<float, 16> &A);
 
-#endif
\ No newline at end of file
+// Transform count world space vertices, given as separate x, y and z arrays
+// with w = 1, to screen space. Perspective divide and viewport mapping are
+// done in the same pass, and outcode receives the clip planes each vertex
+// is outside of. Runs the transform kernel selected by getKernels().
+void transformVerticesToScreen(const std::array<float, 16> &A, const float* inX, const float* inY, const float* inZ,
+                               size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                               float* outX, float* outY, float* outZ, uint8_t* outcode);
+
+#endif
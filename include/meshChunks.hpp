@@ -0,0 +1,58 @@
+#ifndef MESH_CHUNKS
+#define MESH_CHUNKS
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "screenRender.hpp"
+
+// Chunked mesh file (.chunks) for models too large to load at once. The
+// model is split into chunks of nearby triangles, grouped by centroid,
+// that can each be read on their own.
+//
+// Layout, native endian:
+//   chunkFileHeader
+//   chunkInfo[chunkCount]
+//   triangle data, 9 floats per triangle (A, B, C positions)
+
+constexpr char CHUNK_FILE_MAGIC[8] = {'O', 'B', 'J', 'C', 'H', 'N', 'K', '\0'};
+constexpr uint32_t CHUNK_FILE_VERSION = 1;
+
+struct chunkFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+    float boundsMin[3], boundsMax[3]; // Bounding box of the whole model
+};
+
+struct chunkInfo {
+    float boundsMin[3], boundsMax[3]; // Bounding box of the chunk's triangles
+    uint64_t offset; // Byte offset of the chunk's triangles from the start of the file
+    uint32_t triangleCount;
+    uint32_t reserved;
+};
+
+// Bytes of triangle data per triangle in the file
+constexpr size_t CHUNK_TRIANGLE_BYTES = 9 * sizeof(float);
+
+// Most triangles a chunk made by objToChunks holds by default, 2 MB once
+// loaded as worldTriangle
+constexpr uint32_t CHUNK_MAX_TRIANGLES = 32768;
+
+// Convert filename.obj to filename.chunks. The model's bounding box is split
+// as an octree until each node holds at most maxChunkTriangles triangles,
+// so dense regions get small chunks and sparse ones large. Faces are
+// streamed from the .obj, only vertex positions are held in memory. The
+// file is written under a temporary name and renamed once complete. Returns
+// false if the .obj cannot be read or the .chunks file cannot be written.
+bool objToChunks(std::string filename, uint32_t maxChunkTriangles = CHUNK_MAX_TRIANGLES);
+
+// Read the header and chunk table of an open .chunks file, returns false if
+// the file is not a valid chunk file or is shorter than its table says
+bool readChunkTable(std::ifstream &file, chunkFileHeader &header, std::vector<chunkInfo> &chunks);
+
+// Read one chunk's triangles into triangleArray, replacing its contents
+bool readChunkTriangles(std::ifstream &file, const chunkInfo &chunk, std::vector<worldTriangle> &triangleArray);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef REPROJECTION
+#define REPROJECTION
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "compactMesh.hpp"
+#include "frameArena.hpp"
+#include "screenRender.hpp"
+
+// Builds frames by warping an earlier one into the new view, so small
+// camera moves only need the parts of the image that changed to be redrawn.
+//
+// The last full redraw is kept as the reference frame. Every frame warps it
+// into the new view from the matrix it was drawn with, so resampling errors
+// do not build up over frames. Tiles left with holes, where hidden or off
+// screen surfaces came into view, or covering geometry added since the
+// reference, are cleared and redrawn. So are tiles showing space in front
+// of their warped surfaces that was outside the reference view, where close
+// objects can come into view when strafing without leaving a hole.
+// Reference pixels are drawn over the area the warp spreads them across, so
+// surfaces the camera moves towards stay closed. Where that is more than a
+// couple of pixels, the tile is redrawn instead.
+// Everything is redrawn, giving a new reference, every refreshInterval
+// frames or when more than maxDirtyFraction of the tiles need redrawing.
+//
+// Geometry closer than the reference's near plane is not looked for, it
+// only appears once its tiles are redrawn for another reason.
+//
+// Per frame: reproject(), markStale() for anything added to the scene since
+// the last frame, prepareRedraw(), draw with the returned tile mask, then
+// finishFrame().
+class Reprojector {
+    private:
+    AlignedBuffer<colorARGB> referenceColor;
+    AlignedBuffer<float> referenceDepth;
+    std::array<float, 16> referenceM; // Matrix the reference was drawn with
+    std::array<float, 16> referenceInverse;
+    float nearestReferenceDepth; // Depth of the nearest reference pixel
+    std::vector<std::array<float, 6>> staleBoxes; // World space boxes missing from the reference, min then max
+    AlignedBuffer<uint8_t> dirty; // Tiles to redraw this frame
+
+    struct warpedPixel {
+        float x, y, depth; // Position and depth in the new view
+        float inverseDepth; // One over view depth in the reference, 0 if nothing was warped
+    };
+    AlignedBuffer<warpedPixel> warpRows; // Three rows of warped reference pixels
+    AlignedBuffer<uint8_t> holeStates; // Whether _fillBackground can fill each hole
+    AlignedBuffer<uint32_t> holeSources; // Reference pixel each hole would be filled from
+    std::array<float, 16> combinedM;
+    size_t width, height;
+    size_t tilesX, tilesY;
+    size_t dirtyTiles;
+    unsigned int refreshInterval;
+    unsigned int framesSinceRefresh;
+    float maxDirtyFraction;
+    bool valid; // Reference frame matches the current size
+    bool fullRedraw;
+
+    public:
+    Reprojector(unsigned int _refreshInterval = 30, float _maxDirtyFraction = 0.5f);
+
+    // Warp the reference frame into imageArr and depthBuffer for the view
+    // combinedM, and mark tiles left with holes for redrawing
+    void reproject(const std::array<float, 16> &_combinedM, size_t _width, size_t _height,
+                   AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer);
+    // Mark the tiles covering a world space box for redrawing until the next
+    // full redraw, for geometry added to the scene after the reference
+    void markStale(const float boundsMin[3], const float boundsMax[3]);
+    // True if any tile a world space box covers will be redrawn this frame,
+    // so drawing can skip geometry that cannot reach a redrawn tile. Valid
+    // between prepareRedraw() and finishFrame().
+    bool boxNeedsRedraw(const float boundsMin[3], const float boundsMax[3]) const;
+    // Clear the tiles to redraw. Returns the tile mask for drawTriangles, or
+    // nullptr if the whole frame was cleared and everything must be drawn.
+    const uint8_t* prepareRedraw(AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer);
+    // Keep the frame as the new reference if it was drawn in full
+    void finishFrame(const AlignedBuffer<colorARGB> &imageArr, const AlignedBuffer<float> &depthBuffer);
+    // Redraw everything next frame
+    void invalidate() {valid = false;}
+
+    // Tile mask prepareRedraw() returned for this frame
+    const uint8_t* getRedrawTiles() const {return fullRedraw ? nullptr : dirty.data();}
+    // Tiles redrawn by the last frame, and whether that was all of them
+    size_t getDirtyTiles() const {return dirtyTiles;}
+    size_t getTileCount() const {return tilesX * tilesY;}
+    bool wasFullRedraw() const {return fullRedraw;}
+    unsigned int getRefreshInterval() const {return refreshInterval;}
+
+    private:
+    void _warpReference(colorARGB* pixels, float* depths);
+    void _fillBackground(colorARGB* pixels, float* depths);
+    void _fillCracks(colorARGB* pixels, float* depths);
+    // True if the reference saw every point along the ray through a pixel,
+    // T takes pixels and depth in the new view to the reference
+    bool _rayWasSeen(const std::array<float, 16> &T, float pixelX, float pixelY) const;
+    bool _tileHasHole(size_t tileX, size_t tileY, const float* depths) const;
+    // Mark tiles that show space the reference view did not cover
+    void _markUnseenTiles(const float* depths);
+    // Range of tiles a world space box covers on screen, returns false if
+    // none. A box reaching behind the camera covers every tile.
+    bool _boxTiles(const std::array<float, 6> &box, size_t &firstX, size_t &lastX,
+                   size_t &firstY, size_t &lastY) const;
+    void _markBox(const std::array<float, 6> &box);
+};
+
+// Render triangles by reprojecting the previous frames, redrawing only the
+// tiles that need it
+void renderReprojected(Camera &camera, Reprojector &reprojector, std::vector<worldTriangle> &triangles,
+                       size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr,
+                       AlignedBuffer<float> &depthBuffer, FrameArena &arena);
+void renderReprojected(Camera &camera, Reprojector &reprojector, const compactMesh &mesh,
+                       size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr,
+                       AlignedBuffer<float> &depthBuffer, FrameArena &arena);
+
+#endif
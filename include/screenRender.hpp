@@ -1,17 +1,31 @@
 #ifndef SCREEN_RENDER
 #define SCREEN_RENDER
 
+#ifdef _WIN32
 #include <windows.h>
-#include <gdiplus.h>
+#endif
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 #include <algorithm>
+#include "frameArena.hpp"
+#include "kernels.hpp"
+
+// Pixel colour, 8 bits each of alpha, red, green and blue from the high
+// byte down, the same layout as Gdiplus::ARGB
+typedef uint32_t colorARGB;
+
+constexpr colorARGB makeARGB(uint8_t a, uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<colorARGB> (a) << 24) | (static_cast<colorARGB> (r) << 16) |
+           (static_cast<colorARGB> (g) << 8) | static_cast<colorARGB> (b);
+}
 
 struct point4D {
     float x, y, z, w;
-    point4D() {x = 0; y = 0; z = 0; w = 1;}
-    point4D(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
-    point4D(point4D A, point4D B) { //Vector
+    constexpr point4D() : x(0), y(0), z(0), w(1) {}
+    constexpr point4D(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+    constexpr point4D(point4D A, point4D B) { //Vector
         x = B.x - A.x;
         y = B.y - A.y;
         z = B.z - A.z;
@@ -75,7 +89,7 @@ class Camera {
     void setFar(float _farPlaneDist) {farPlaneDist = _farPlaneDist;}
 
     // Updates the viewing angle depending on the raw mouse positon deltas
-    void updateViewAngle(LONG deltaX, LONG deltaY) {
+    void updateViewAngle(long deltaX, long deltaY) {
         yawTemp = yaw + -deltaX / 250.0f; // Divide by 250 to decrease sensitivity
         pitchTemp = pitch + -deltaY / 250.0f; // TODO: add sensitivity control to camera
         yawTemp = fmodf(yawTemp, 2 * M_PI);
@@ -91,8 +105,10 @@ class Camera {
         cameraViewVec.w = 1;
     }
 
+#ifdef _WIN32
     // Update camera data depending on key pressed
     bool updateCameraPos(HWND hWnd, UINT Message, USHORT VKey);
+#endif
 };
 
 class worldTriangle {
@@ -129,6 +145,16 @@ class worldTriangle {
     }
 };
 
+// Flat colour of a face, set depending on its normal vector direction
+inline colorARGB faceColor(point4D normal) {
+    return makeARGB(
+        0xFF,
+        static_cast<uint8_t> (0xFF * (normal.x+1)/2),
+        static_cast<uint8_t> (0xFF * (normal.y+1)/2),
+        static_cast<uint8_t> (0xFF * (normal.z+1)/2)
+    );
+}
+
 class screenTriangle {
     private:
     point4D A, B, C; //Vertecies of triangle in 2D screen space
@@ -155,8 +181,6 @@ class screenTriangle {
 
         detInverse = 1 / (v0x * v1y - v0y * v1x); // Compute detInverse here for faster barycentric coordinates
     }
-    //Construct a screenTriangle from the world triangle, camera data, and screen data
-    screenTriangle(worldTriangle &worldTri, Camera &camera, float width, float height, std::array<float, 16> &matrix);
 
     // Check if a point is in the bounds of the triangle, and compute depth for z-buffering
     // Returns true if pixel is inside triangle
@@ -176,6 +200,9 @@ class screenTriangle {
     int getBottom() const {return triBottom;}
     int getLeft() const {return triLeft;}
     int getRight() const {return triRight;}
+    spanSetup getSpanSetup() const {
+        return {A.x, A.y, A.z, B.z, C.z, v0x, v0y, v1x, v1y, detInverse};
+    }
 
     private:
     // Compute the barycentric coordinates of the point (Px, Py) in screen space
@@ -188,9 +215,50 @@ class screenTriangle {
     }
 };
 
-// Load the rendered frame into imageArr
-void renderImage(Camera &camera, std::vector<worldTriangle> &triangles, size_t width, size_t height, std::vector<Gdiplus::ARGB> &imageArr, std::vector<float> &depthBuffer);
+// Combined world to clip space matrix for the camera and image size
+std::array<float, 16> viewProjectionMatrix(Camera &camera, size_t width, size_t height);
+// Clear imageArr to black and depthBuffer to the far plane
+void clearImage(size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer);
+// Side length in pixels of the square tiles partial redraws work in
+constexpr int REDRAW_TILE_SIZE = 32;
+// Triangles drawn per gather, transform and rasterize pass. Small enough
+// that a batch's arrays stay in cache between the passes.
+constexpr size_t DRAW_BATCH_SIZE = 2048;
+// Scratch arrays for drawing one batch, allocated from arena. Allocate one
+// per frame and pass it to every draw call, so arena use does not grow with
+// the number of calls. Front facing triangles are gathered into it, three
+// vertices and a face colour each, then drawn by flushBatch() whenever it
+// fills up and once at the end of the draw call.
+struct drawBatch {
+    float* worldX;
+    float* worldY;
+    float* worldZ;
+    colorARGB* colors;
+    float* screenX;
+    float* screenY;
+    float* screenZ;
+    uint8_t* outcode;
+    size_t count; // Triangles gathered so far
+
+    explicit drawBatch(FrameArena &arena);
+};
+// Rasterize triangles into imageArr and depthBuffer without clearing them first,
+// combinedM is the matrix from viewProjectionMatrix. If dirtyTiles is set, only
+// pixels in tiles marked non-zero are drawn, one byte per tile in row order.
+void drawTriangles(Camera &camera, const worldTriangle* triangles, size_t triangleCount, const std::array<float, 16> &combinedM,
+                   size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer,
+                   drawBatch &batch, const uint8_t* dirtyTiles = nullptr);
+// Transform and rasterize the triangles gathered in batch, then empty it.
+// dirtyTiles is the same as for drawTriangles.
+void flushBatch(drawBatch &batch, Camera &camera, const std::array<float, 16> &combinedM, size_t width, size_t height,
+                AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, const uint8_t* dirtyTiles = nullptr);
+// Load the rendered frame into imageArr. Transient per-frame data is
+// allocated from arena, which the caller resets once per frame
+void renderImage(Camera &camera, std::vector<worldTriangle> &triangles, size_t width, size_t height,
+                 AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena);
+#ifdef _WIN32
 // Paint the imageArr buffer to the screen
-void OnPaint(HDC hdc, size_t width, size_t height, std::vector<Gdiplus::ARGB> &imageArr, Camera &camera);
+void OnPaint(HDC hdc, size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, Camera &camera);
+#endif
 
 #endif
\ No newline at end of file
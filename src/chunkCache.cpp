@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chunkCache.hpp"
+#include "matrices.hpp"
+#include "meshChunks.hpp"
+#include "reprojection.hpp"
+#include "screenRender.hpp"
+
+namespace {
+
+// How many frames of the camera's last movement to look ahead when prefetching
+constexpr float PREFETCH_FRAMES = 30.0f;
+
+// True if the box lies entirely outside one of the view volume's planes
+bool boxOutsideView(const std::array<float, 16> &combinedM, const chunkInfo &chunk, float nearPlaneDist, float farPlaneDist) {
+    unsigned int outside = 0x3F;
+    for(int corner = 0; corner < 8; corner++) {
+        point4D p((corner & 1) ? chunk.boundsMax[0] : chunk.boundsMin[0],
+                  (corner & 2) ? chunk.boundsMax[1] : chunk.boundsMin[1],
+                  (corner & 4) ? chunk.boundsMax[2] : chunk.boundsMin[2], 1);
+        p = matrixVectorMultiply(combinedM, p);
+        unsigned int code = (p.x < -p.w ? CLIP_LEFT : 0) | (p.x > p.w ? CLIP_RIGHT : 0) |
+                            (p.y < -p.w ? CLIP_BOTTOM : 0) | (p.y > p.w ? CLIP_TOP : 0) |
+                            (p.w < nearPlaneDist ? CLIP_NEAR : 0) | (p.w > farPlaneDist ? CLIP_FAR : 0); // w is view space depth
+        outside &= code;
+        if(outside == 0) return false;
+    }
+    return true;
+}
+
+size_t chunkBytes(const chunkInfo &chunk) {
+    return chunk.triangleCount * sizeof(worldTriangle);
+}
+
+}
+
+ChunkCache::ChunkCache(std::string filename, size_t _memoryCap) :
+    memoryCap(_memoryCap), residentBytes(0), queuedBytes(0), frame(0), canEvict(true), open(false),
+    stopping(false), path(filename.append(".chunks")) {
+
+    std::ifstream file(path, std::ios::binary);
+    chunkFileHeader header;
+    if(!file || !readChunkTable(file, header, chunks)) return;
+
+    states.assign(chunks.size(), chunkState::unloaded);
+    triangles.resize(chunks.size());
+    lastUsedFrame.assign(chunks.size(), 0);
+    lastDrawnFrame.assign(chunks.size(), 0);
+    visible.reserve(chunks.size());
+    newlyVisible.reserve(chunks.size());
+    completed.reserve(chunks.size());
+    arrived.reserve(chunks.size());
+    open = true;
+    loader = std::thread(&ChunkCache::_loaderLoop, this);
+}
+
+ChunkCache::~ChunkCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if(loader.joinable()) loader.join();
+}
+
+void ChunkCache::update(Camera &camera, const std::array<float, 16> &combinedM) {
+    _collectCompleted();
+    frame++;
+    canEvict = true;
+
+    visible.clear();
+    newlyVisible.clear();
+    for(size_t i = 0; i < chunks.size(); i++) {
+        if(boxOutsideView(combinedM, chunks[i], camera.getNear(), camera.getFar())) continue;
+        visible.push_back(i);
+        if(states[i] == chunkState::resident && lastDrawnFrame[i] != frame - 1) newlyVisible.push_back(i);
+        lastUsedFrame[i] = frame;
+    }
+
+    point4D cameraPos = camera.getPos();
+    auto distanceSq = [&](size_t i) {
+        const chunkInfo &chunk = chunks[i];
+        float dx = (chunk.boundsMin[0] + chunk.boundsMax[0]) * 0.5f - cameraPos.x;
+        float dy = (chunk.boundsMin[1] + chunk.boundsMax[1]) * 0.5f - cameraPos.y;
+        float dz = (chunk.boundsMin[2] + chunk.boundsMax[2]) * 0.5f - cameraPos.z;
+        return dx * dx + dy * dy + dz * dz;
+    };
+    std::sort(visible.begin(), visible.end(), [&](size_t a, size_t b) {return distanceSq(a) < distanceSq(b);});
+
+    for(size_t i : visible) { // Nearest chunks first, skipping any that do not fit
+        if(states[i] == chunkState::unloaded) _request(i, true);
+    }
+
+    // Prefetch chunks that will be visible if the camera keeps moving the same way
+    if(frame == 1) lastCameraPos = cameraPos;
+    point4D motion(lastCameraPos, cameraPos);
+    lastCameraPos = cameraPos;
+    if(motion.x == 0 && motion.y == 0 && motion.z == 0) return;
+
+    std::array<float, 16> aheadM = matrixMultiply(combinedM, translationMatrix(-motion.x * PREFETCH_FRAMES,
+                                                                               -motion.y * PREFETCH_FRAMES,
+                                                                               -motion.z * PREFETCH_FRAMES));
+    for(size_t i = 0; i < chunks.size(); i++) {
+        if(states[i] != chunkState::unloaded) continue;
+        if(boxOutsideView(aheadM, chunks[i], camera.getNear(), camera.getFar())) continue;
+        if(_request(i, false)) lastUsedFrame[i] = frame;
+    }
+}
+
+void ChunkCache::draw(Camera &camera, const std::array<float, 16> &combinedM, size_t width, size_t height,
+                      AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena,
+                      const Reprojector* reprojector) {
+    const uint8_t* dirtyTiles = reprojector != nullptr ? reprojector->getRedrawTiles() : nullptr;
+    drawBatch batch(arena); // Shared by every chunk, the arena is only reset once per frame
+    for(size_t i : visible) {
+        if(states[i] != chunkState::resident) continue;
+        lastDrawnFrame[i] = frame;
+        if(dirtyTiles != nullptr && !reprojector->boxNeedsRedraw(chunks[i].boundsMin, chunks[i].boundsMax)) continue;
+        drawTriangles(camera, triangles[i].data(), triangles[i].size(), combinedM, width, height, imageArr, depthBuffer,
+                      batch, dirtyTiles);
+    }
+}
+
+void ChunkCache::_loaderLoop() {
+    std::ifstream file(path, std::ios::binary);
+
+    while(true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] {return stopping || !requests.empty() || !prefetchRequests.empty();});
+            if(stopping) return;
+            std::deque<size_t> &queue = requests.empty() ? prefetchRequests : requests;
+            index = queue.front();
+            queue.pop_front();
+        }
+
+        loadedChunk loaded {index, {}};
+        if(!readChunkTriangles(file, chunks[index], loaded.triangles)) {
+            loaded.triangles = std::vector<worldTriangle>(); // Failed reads come back empty
+            file.clear();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(std::move(loaded));
+    }
+}
+
+void ChunkCache::_collectCompleted() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(arrived, completed);
+    }
+
+    for(loadedChunk &loaded : arrived) {
+        size_t bytes = chunkBytes(chunks[loaded.index]);
+        queuedBytes -= bytes;
+        if(loaded.triangles.size() != chunks[loaded.index].triangleCount) {
+            states[loaded.index] = chunkState::failed; // Retrying would fail again every frame
+            continue;
+        }
+        triangles[loaded.index] = std::move(loaded.triangles);
+        states[loaded.index] = chunkState::resident;
+        residentBytes += bytes;
+    }
+    arrived.clear();
+}
+
+bool ChunkCache::_request(size_t chunk, bool urgent) {
+    size_t bytes = chunkBytes(chunks[chunk]);
+    if(bytes > memoryCap) return false;
+    while(residentBytes + queuedBytes + bytes > memoryCap) {
+        if(!canEvict || !_evictOne()) {
+            canEvict = false;
+            return false;
+        }
+    }
+
+    states[chunk] = chunkState::queued;
+    queuedBytes += bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (urgent ? requests : prefetchRequests).push_back(chunk);
+    }
+    wake.notify_one();
+    return true;
+}
+
+bool ChunkCache::_evictOne() {
+    size_t oldest = SIZE_MAX;
+    for(size_t i = 0; i < chunks.size(); i++) { // Least recently used resident chunk not needed this frame
+        if(states[i] != chunkState::resident || lastUsedFrame[i] >= frame) continue;
+        if(oldest == SIZE_MAX || lastUsedFrame[i] < lastUsedFrame[oldest]) oldest = i;
+    }
+    if(oldest == SIZE_MAX) return false;
+
+    triangles[oldest] = std::vector<worldTriangle>(); // Release the memory, clear() would keep it
+    states[oldest] = chunkState::unloaded;
+    residentBytes -= chunkBytes(chunks[oldest]);
+    return true;
+}
+
+void renderStreamed(Camera &camera, ChunkCache &cache, size_t width, size_t height,
+                    AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena,
+                    Reprojector* reprojector) {
+
+    std::array<float, 16> combinedM = viewProjectionMatrix(camera, width, height);
+    cache.update(camera, combinedM);
+    if(reprojector == nullptr) {
+        clearImage(width, height, imageArr, depthBuffer);
+        cache.draw(camera, combinedM, width, height, imageArr, depthBuffer, arena);
+        return;
+    }
+
+    // Chunks that were not in the last frame are missing from the reprojected
+    // image wherever they are, not just in holes
+    reprojector->reproject(combinedM, width, height, imageArr, depthBuffer);
+    for(size_t i : cache.getNewlyVisible()) {
+        reprojector->markStale(cache.getChunk(i).boundsMin, cache.getChunk(i).boundsMax);
+    }
+    reprojector->prepareRedraw(imageArr, depthBuffer);
+    cache.draw(camera, combinedM, width, height, imageArr, depthBuffer, arena, reprojector);
+    reprojector->finishFrame(imageArr, depthBuffer);
+}
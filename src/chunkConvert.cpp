@@ -0,0 +1,38 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "meshChunks.hpp"
+
+// Converts a .obj model to the .chunks file that the renderer's --stream
+// mode reads. Run once ahead of time, the renderer never converts itself.
+//
+// chunkConvert NAME [--max-chunk-triangles N]
+//
+// Reads NAME.obj and writes NAME.chunks. Only the model's vertex positions
+// are held in memory, faces are streamed from the file.
+int main(int argc, char** argv) {
+    std::string name;
+    unsigned long maxChunkTriangles = CHUNK_MAX_TRIANGLES;
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if(arg == "--max-chunk-triangles" && i + 1 < argc) {
+            maxChunkTriangles = std::strtoul(argv[++i], nullptr, 10);
+        } else if(name.empty() && !arg.starts_with("--")) {
+            name = arg;
+        } else {
+            name.clear();
+            break;
+        }
+    }
+    if(name.empty() || maxChunkTriangles == 0 || maxChunkTriangles > UINT32_MAX) {
+        std::fprintf(stderr, "usage: chunkConvert NAME [--max-chunk-triangles N]\n");
+        return 2;
+    }
+
+    if(!objToChunks(name, static_cast<uint32_t> (maxChunkTriangles))) {
+        std::fprintf(stderr, "could not convert %s.obj to %s.chunks\n", name.c_str(), name.c_str());
+        return 1;
+    }
+    std::printf("wrote %s.chunks\n", name.c_str());
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "compactMesh.hpp"
+#include "frameArena.hpp"
+#include "matrices.hpp"
+#include "screenRender.hpp"
+
+namespace {
+
+constexpr float QUANTIZE_MAX = 65535.0f;
+
+// Angle between two vectors, from atan2 as acos loses precision close to 0
+float angleDegrees(point4D a, point4D b) {
+    float crossX = a.y * b.z - a.z * b.y;
+    float crossY = a.z * b.x - a.x * b.z;
+    float crossZ = a.x * b.y - a.y * b.x;
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z;
+    return std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * (180.0f / static_cast<float> (M_PI));
+}
+
+}
+
+void buildCompactMesh(const std::vector<worldTriangle> &triangles, compactMesh &mesh) {
+    float boundsMin[3] = {INFINITY, INFINITY, INFINITY};
+    float boundsMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for(const worldTriangle &triangle : triangles) {
+        for(point4D p : {triangle.getAPos(), triangle.getBPos(), triangle.getCPos()}) {
+            float coords[3] = {p.x, p.y, p.z};
+            for(int axis = 0; axis < 3; axis++) {
+                boundsMin[axis] = std::min(boundsMin[axis], coords[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], coords[axis]);
+            }
+        }
+    }
+
+    for(int axis = 0; axis < 3; axis++) {
+        if(triangles.empty()) boundsMin[axis] = boundsMax[axis] = 0;
+        mesh.origin[axis] = boundsMin[axis];
+        mesh.step[axis] = (boundsMax[axis] - boundsMin[axis]) / QUANTIZE_MAX;
+    }
+
+    mesh.triangles.clear();
+    mesh.triangles.reserve(triangles.size());
+    for(const worldTriangle &triangle : triangles) {
+        compactTriangle compact {};
+        point4D vertices[3] = {triangle.getAPos(), triangle.getBPos(), triangle.getCPos()};
+        for(int vertex = 0; vertex < 3; vertex++) {
+            float coords[3] = {vertices[vertex].x, vertices[vertex].y, vertices[vertex].z};
+            for(int axis = 0; axis < 3; axis++) {
+                if(mesh.step[axis] == 0) continue; // Flat along this axis, every vertex is at the origin
+                double steps = (static_cast<double> (coords[axis]) - mesh.origin[axis]) / mesh.step[axis];
+                compact.position[3 * vertex + axis] = static_cast<uint16_t> (std::clamp(std::round(steps), 0.0, 65535.0));
+            }
+        }
+        colorARGB color = faceColor(triangle.getNormal());
+        compact.color[0] = static_cast<uint16_t> (color);
+        compact.color[1] = static_cast<uint16_t> (color >> 16);
+        mesh.triangles.push_back(compact);
+    }
+}
+
+point4D decodePosition(const compactMesh &mesh, const compactTriangle &triangle, int vertex) {
+    const uint16_t* q = triangle.position + 3 * vertex;
+    return point4D(mesh.origin[0] + q[0] * mesh.step[0],
+                   mesh.origin[1] + q[1] * mesh.step[1],
+                   mesh.origin[2] + q[2] * mesh.step[2], 1);
+}
+
+compactError measureCompactError(const std::vector<worldTriangle> &triangles, const compactMesh &mesh) {
+    // Rounding to the nearest step is off by at most half a step on each
+    // axis, plus float rounding when decoding
+    float boundSq = 0;
+    for(int axis = 0; axis < 3; axis++) {
+        float largest = std::max(std::fabs(mesh.origin[axis]), std::fabs(mesh.origin[axis] + QUANTIZE_MAX * mesh.step[axis]));
+        float axisBound = 0.5f * mesh.step[axis] + 2 * std::numeric_limits<float>::epsilon() * largest;
+        boundSq += axisBound * axisBound;
+    }
+
+    compactError error {std::sqrt(boundSq), 0, 0};
+    for(size_t i = 0; i < triangles.size() && i < mesh.triangles.size(); i++) {
+        const worldTriangle &original = triangles[i];
+        point4D vertices[3] = {original.getAPos(), original.getBPos(), original.getCPos()};
+        for(int vertex = 0; vertex < 3; vertex++) {
+            point4D offset(vertices[vertex], decodePosition(mesh, mesh.triangles[i], vertex));
+            float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+            error.positionMeasured = std::max(error.positionMeasured, distance);
+        }
+
+        point4D normal = original.getNormal();
+        point4D decodedNormal = worldTriangle(decodePosition(mesh, mesh.triangles[i], 0), decodePosition(mesh, mesh.triangles[i], 1),
+                                              decodePosition(mesh, mesh.triangles[i], 2)).getNormal();
+        if(!std::isfinite(normal.x + normal.y + normal.z + decodedNormal.x + decodedNormal.y + decodedNormal.z)) {
+            continue; // Degenerate before or after quantizing, has no direction to keep
+        }
+        error.normalDegrees = std::max(error.normalDegrees, angleDegrees(normal, decodedNormal));
+    }
+    return error;
+}
+
+float screenErrorBound(const compactError &error, const Camera &camera, size_t width, size_t height, float depth) {
+    // A world space offset moves a projected point by up to
+    // sqrt(1 + tan^2 across + tan^2 up) times its length over the depth,
+    // largest in the corners of the view
+    float tanAcross = std::tan(camera.getFovR() * 0.5f);
+    float tanUp = tanAcross * static_cast<float> (height) / static_cast<float> (width);
+    float pixelsPerUnit = static_cast<float> (width) * 0.5f / tanAcross;
+    return error.positionBound * pixelsPerUnit / depth * std::sqrt(1 + tanAcross * tanAcross + tanUp * tanUp);
+}
+
+void drawCompactTriangles(Camera &camera, const compactMesh &mesh, const std::array<float, 16> &combinedM,
+                          size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer,
+                          drawBatch &batch, const uint8_t* dirtyTiles) {
+
+    // Gather quantized positions of front facing triangles, the transform
+    // dequantizes them along with the rest of the view projection
+    std::array<float, 16> decodeM = matrixMultiply(combinedM, matrixMultiply(
+        translationMatrix(mesh.origin[0], mesh.origin[1], mesh.origin[2]),
+        scaleMatrix(mesh.step[0], mesh.step[1], mesh.step[2])));
+
+    // The world space normal of a triangle is the cross product of its
+    // quantized edges scaled by these, before normalizing
+    float normalScale[3] = {mesh.step[1] * mesh.step[2], mesh.step[2] * mesh.step[0], mesh.step[0] * mesh.step[1]};
+    point4D cameraPos = camera.getPos();
+    for(const compactTriangle &triangle : mesh.triangles) {
+        const uint16_t* q = triangle.position;
+        point4D edgeAB(q[3] - q[0], q[4] - q[1], q[5] - q[2], 1);
+        point4D edgeAC(q[6] - q[0], q[7] - q[1], q[8] - q[2], 1);
+        point4D normal(normalScale[0] * (edgeAB.y * edgeAC.z - edgeAB.z * edgeAC.y),
+                       normalScale[1] * (edgeAB.z * edgeAC.x - edgeAB.x * edgeAC.z),
+                       normalScale[2] * (edgeAB.x * edgeAC.y - edgeAB.y * edgeAC.x), 1);
+        point4D cameraVec(cameraPos, decodePosition(mesh, triangle, 0));
+        if((normal.x * cameraVec.x + normal.y * cameraVec.y + normal.z * cameraVec.z) > 0.0f) continue; //Dot product for backface culling
+
+        size_t first = 3 * batch.count;
+        for(size_t j = 0; j < 3; j++) {
+            batch.worldX[first + j] = q[3 * j];
+            batch.worldY[first + j] = q[3 * j + 1];
+            batch.worldZ[first + j] = q[3 * j + 2];
+        }
+        batch.colors[batch.count] = triangle.getColor();
+        if(++batch.count == DRAW_BATCH_SIZE) flushBatch(batch, camera, decodeM, width, height, imageArr, depthBuffer, dirtyTiles);
+    }
+    flushBatch(batch, camera, decodeM, width, height, imageArr, depthBuffer, dirtyTiles);
+}
+
+void renderCompactImage(Camera &camera, const compactMesh &mesh, size_t width, size_t height,
+                        AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena) {
+
+    clearImage(width, height, imageArr, depthBuffer);
+    std::array<float, 16> combinedM = viewProjectionMatrix(camera, width, height);
+    drawBatch batch(arena);
+    drawCompactTriangles(camera, mesh, combinedM, width, height, imageArr, depthBuffer, batch);
+}
@@ -0,0 +1,135 @@
+#include <cstdlib>
+#include <cstring>
+#include "kernels.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+
+struct cpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+    bool avx512 = false;
+};
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for(int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int> (info[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switch, bit 1 SSE, bit 2 AVX,
+// bits 5 to 7 AVX-512
+unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long> (edx) << 32) | eax;
+#endif
+}
+
+cpuFeatures detectFeatures() {
+    cpuFeatures features;
+    unsigned int regs[4]; // eax, ebx, ecx, edx
+
+    cpuid(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+    if(maxLeaf < 1) return features;
+
+    cpuid(1, 0, regs);
+    features.sse41 = (regs[2] >> 19) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    if(!osxsave || !avx || maxLeaf < 7) return features;
+
+    unsigned long long xcr0 = xgetbv0();
+    bool osAvx = (xcr0 & 0x6) == 0x6;
+    bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+    cpuid(7, 0, regs);
+    features.avx2 = osAvx && ((regs[1] >> 5) & 1);
+    features.avx512 = features.avx2 && osAvx512 && ((regs[1] >> 16) & 1); // AVX-512F
+    return features;
+}
+
+const cpuFeatures& getFeatures() {
+    static const cpuFeatures features = detectFeatures();
+    return features;
+}
+
+const renderKernels* selectInitialKernels() {
+    kernelIsa isa = bestSupportedIsa();
+    const char* name = std::getenv("RENDERER_KERNELS");
+    kernelIsa forced;
+    if(name != nullptr && parseKernelIsa(name, forced) && isaSupported(forced)) isa = forced;
+    return &kernelsForIsa(isa);
+}
+
+const renderKernels* selectedKernels = nullptr;
+
+}
+
+bool isaSupported(kernelIsa isa) {
+    const cpuFeatures &features = getFeatures();
+    switch(isa) {
+        case kernelIsa::scalar:
+            return true;
+        case kernelIsa::sse41:
+            return features.sse41;
+        case kernelIsa::avx2:
+            return features.avx2;
+        case kernelIsa::avx512:
+            return features.avx512;
+    }
+    return false;
+}
+
+kernelIsa bestSupportedIsa() {
+    if(isaSupported(kernelIsa::avx512)) return kernelIsa::avx512;
+    if(isaSupported(kernelIsa::avx2)) return kernelIsa::avx2;
+    if(isaSupported(kernelIsa::sse41)) return kernelIsa::sse41;
+    return kernelIsa::scalar;
+}
+
+const renderKernels& kernelsForIsa(kernelIsa isa) {
+    switch(isa) {
+        case kernelIsa::sse41:
+            return sse41Kernels;
+        case kernelIsa::avx2:
+            return avx2Kernels;
+        case kernelIsa::avx512:
+            return avx512Kernels;
+        default:
+            return scalarKernels;
+    }
+}
+
+const renderKernels& getKernels() {
+    if(selectedKernels == nullptr) selectedKernels = selectInitialKernels();
+    return *selectedKernels;
+}
+
+bool forceKernelIsa(kernelIsa isa) {
+    if(!isaSupported(isa)) return false;
+    selectedKernels = &kernelsForIsa(isa);
+    return true;
+}
+
+bool parseKernelIsa(const char* name, kernelIsa &isa) {
+    if(std::strcmp(name, "scalar") == 0) isa = kernelIsa::scalar;
+    else if(std::strcmp(name, "sse41") == 0) isa = kernelIsa::sse41;
+    else if(std::strcmp(name, "avx2") == 0) isa = kernelIsa::avx2;
+    else if(std::strcmp(name, "avx512") == 0) isa = kernelIsa::avx512;
+    else return false;
+    return true;
+}
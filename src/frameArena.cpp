@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "frameArena.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+    std::atomic<size_t> totalAllocationCount {0};
+    std::atomic<size_t> frameStartCount {0};
+}
+
+void* alignedAlloc(size_t bytes, size_t alignment) {
+    totalAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if(bytes == 0) bytes = 1;
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(bytes, alignment);
+#else
+    bytes = (bytes + alignment - 1) & ~(alignment - 1); // aligned_alloc needs a multiple of alignment
+    void* ptr = std::aligned_alloc(alignment, bytes);
+#endif
+    if(ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void alignedFree(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void allocStats::beginFrame() {
+    frameStartCount.store(totalAllocationCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+size_t allocStats::frameAllocations() {
+    return totalAllocationCount.load(std::memory_order_relaxed) - frameStartCount.load(std::memory_order_relaxed);
+}
+
+size_t allocStats::totalAllocations() {
+    return totalAllocationCount.load(std::memory_order_relaxed);
+}
+
+// Replace the global allocation functions so every heap allocation is
+// counted. The array and nothrow forms forward to these by default, and the
+// aligned form is counted by alignedAlloc.
+void* operator new(size_t bytes) {
+    totalAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if(bytes == 0) bytes = 1;
+    void* ptr = std::malloc(bytes);
+    if(ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    return alignedAlloc(bytes, static_cast<size_t> (alignment));
+}
+
+void operator delete(void* ptr) noexcept {std::free(ptr);}
+void operator delete(void* ptr, size_t) noexcept {std::free(ptr);}
+void operator delete(void* ptr, std::align_val_t) noexcept {alignedFree(ptr);}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {alignedFree(ptr);}
+
+FrameArena::FrameArena(size_t initialCapacity) :
+    block(static_cast<char*> (alignedAlloc(initialCapacity, FRAME_ALIGNMENT))),
+    capacity(initialCapacity), offset(0), frameBytes(0), highWater(0) {}
+
+FrameArena::~FrameArena() {
+    for(char* overflow : overflowBlocks) alignedFree(overflow);
+    alignedFree(block);
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+    frameBytes += bytes + (start - offset);
+
+    if(start + bytes <= capacity) {
+        offset = start + bytes;
+        return block + start;
+    }
+
+    // Out of space this frame, fall back to a dedicated block until reset()
+    char* overflow = static_cast<char*> (alignedAlloc(bytes, std::max(alignment, FRAME_ALIGNMENT)));
+    overflowBlocks.push_back(overflow);
+    frameBytes += FRAME_ALIGNMENT; // Leave room for alignment padding when grown
+    return overflow;
+}
+
+void FrameArena::reset() {
+    highWater = std::max(highWater, frameBytes);
+
+    if(!overflowBlocks.empty()) { // Grow to fit the whole frame in one block
+        for(char* overflow : overflowBlocks) alignedFree(overflow);
+        overflowBlocks.clear();
+        alignedFree(block);
+        capacity = highWater + highWater / 4;
+        block = static_cast<char*> (alignedAlloc(capacity, FRAME_ALIGNMENT));
+    }
+
+    offset = 0;
+    frameBytes = 0;
+}
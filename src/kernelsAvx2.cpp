@@ -0,0 +1,126 @@
+#include <immintrin.h>
+#include "kernels.hpp"
+#include "kernelsScalar.hpp"
+
+// Built with AVX2 enabled, only called when the CPU supports it
+
+namespace {
+
+void transformVertices(const float* A, const float* inX, const float* inY, const float* inZ,
+                       size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                       float* outX, float* outY, float* outZ, uint8_t* outcode) {
+    __m256 m[16];
+    for(size_t j = 0; j < 16; j++) m[j] = _mm256_set1_ps(A[j]);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 vWidth = _mm256_set1_ps(width);
+    const __m256 vHeight = _mm256_set1_ps(height);
+    const __m256 vNear = _mm256_set1_ps(-nearPlaneDist);
+    const __m256 vFar = _mm256_set1_ps(farPlaneDist);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(inX + i);
+        __m256 y = _mm256_loadu_ps(inY + i);
+        __m256 z = _mm256_loadu_ps(inZ + i);
+
+        // Multiply and add separately, fused multiply-add would round differently to the scalar path
+        __m256 clipX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], x), _mm256_mul_ps(m[1], y)), _mm256_mul_ps(m[2], z)), m[3]);
+        __m256 clipY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[4], x), _mm256_mul_ps(m[5], y)), _mm256_mul_ps(m[6], z)), m[7]);
+        __m256 clipZ = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[8], x), _mm256_mul_ps(m[9], y)), _mm256_mul_ps(m[10], z)), m[11]);
+        __m256 clipW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[12], x), _mm256_mul_ps(m[13], y)), _mm256_mul_ps(m[14], z)), m[15]);
+        __m256 negW = _mm256_xor_ps(clipW, signBit);
+
+        __m256i code = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, negW, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_LEFT));
+        code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, clipW, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_RIGHT)));
+        code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, negW, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_BOTTOM)));
+        code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, clipW, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_TOP)));
+        code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipZ, vNear, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_NEAR)));
+        code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipZ, vFar, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_FAR)));
+        __m128i code16 = _mm_packus_epi32(_mm256_castsi256_si128(code), _mm256_extracti128_si256(code, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*> (outcode + i), _mm_packus_epi16(code16, code16));
+
+        __m256 screenX = _mm256_sub_ps(vWidth, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(clipX, clipW), one), vWidth), half));
+        __m256 screenY = _mm256_sub_ps(vHeight, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(clipY, clipW), one), vHeight), half));
+        _mm256_storeu_ps(outX + i, screenX);
+        _mm256_storeu_ps(outY + i, screenY);
+        _mm256_storeu_ps(outZ + i, _mm256_div_ps(clipZ, clipW));
+    }
+
+    scalarTransformVertices(A, inX + i, inY + i, inZ + i, count - i, nearPlaneDist, farPlaneDist, width, height,
+                            outX + i, outY + i, outZ + i, outcode + i);
+}
+
+void rasterSpan(const spanSetup &tri, int y, int xBegin, int xEnd, uint32_t color,
+                uint32_t* colorRow, float* depthRow) {
+    const __m256 v0x = _mm256_set1_ps(tri.v0x);
+    const __m256 negV0y = _mm256_set1_ps(-tri.v0y);
+    const __m256 v1x = _mm256_set1_ps(tri.v1x);
+    const __m256 v1y = _mm256_set1_ps(tri.v1y);
+    const __m256 detInverse = _mm256_set1_ps(tri.detInverse);
+    const __m256 az = _mm256_set1_ps(tri.az);
+    const __m256 bz = _mm256_set1_ps(tri.bz);
+    const __m256 cz = _mm256_set1_ps(tri.cz);
+    const __m256 ax = _mm256_set1_ps(tri.ax);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i vColor = _mm256_set1_epi32(static_cast<int> (color));
+    const __m256 v2y = _mm256_set1_ps((y + 0.5f) - tri.ay);
+    const __m256 laneOffset = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int x = xBegin;
+    for(; x + 7 <= xEnd; x += 8) {
+        __m256 v2x = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_set1_epi32(x)), laneOffset), half), ax);
+        __m256 v = _mm256_mul_ps(detInverse, _mm256_sub_ps(_mm256_mul_ps(v1y, v2x), _mm256_mul_ps(v1x, v2y)));
+        __m256 w = _mm256_mul_ps(detInverse, _mm256_add_ps(_mm256_mul_ps(negV0y, v2x), _mm256_mul_ps(v0x, v2y)));
+        __m256 u = _mm256_sub_ps(_mm256_sub_ps(one, v), w);
+        __m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u, az), _mm256_mul_ps(v, bz)), _mm256_mul_ps(w, cz));
+
+        __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)),
+                                      _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+        __m256 write = _mm256_and_ps(inside, _mm256_cmp_ps(depth, _mm256_loadu_ps(depthRow + x), _CMP_LT_OQ));
+        if(_mm256_movemask_ps(write) == 0) continue;
+
+        __m256i writeMask = _mm256_castps_si256(write);
+        _mm256_maskstore_ps(depthRow + x, writeMask, depth);
+        _mm256_maskstore_epi32(reinterpret_cast<int*> (colorRow + x), writeMask, vColor);
+    }
+
+    scalarRasterSpan(tri, y, x, xEnd, color, colorRow, depthRow);
+}
+
+void clearFrame(uint32_t* color, float* depth, size_t count, uint32_t clearColor, float clearDepth) {
+    const __m256i vColor = _mm256_set1_epi32(static_cast<int> (clearColor));
+    const __m256 vDepth = _mm256_set1_ps(clearDepth);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*> (color + i), vColor);
+        _mm256_storeu_ps(depth + i, vDepth);
+    }
+    scalarClearFrame(color + i, depth + i, count - i, clearColor, clearDepth);
+}
+
+void copyFrame(uint8_t* dst, ptrdiff_t dstStride, const uint32_t* src, size_t width, size_t height) {
+    for(size_t y = 0; y < height; y++) {
+        uint32_t* dstRow = reinterpret_cast<uint32_t*> (dst + y * dstStride);
+        const uint32_t* srcRow = src + y * width;
+        size_t x = 0;
+        for(; x + 8 <= width; x += 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*> (dstRow + x), _mm256_loadu_si256(reinterpret_cast<const __m256i*> (srcRow + x)));
+        }
+        scalarCopyRow(dstRow + x, srcRow + x, width - x);
+    }
+}
+
+}
+
+const renderKernels avx2Kernels = {
+    kernelIsa::avx2,
+    "AVX2",
+    transformVertices,
+    rasterSpan,
+    clearFrame,
+    copyFrame
+};
@@ -0,0 +1,129 @@
+#include <immintrin.h>
+#include "kernels.hpp"
+#include "kernelsScalar.hpp"
+
+// Built with AVX-512F enabled, only called when the CPU supports it. Masked
+// loads and stores handle the leftover elements.
+
+namespace {
+
+// Mask with the low count lanes set, count at most 16
+__mmask16 tailMask(size_t count) {
+    return static_cast<__mmask16> ((1u << count) - 1);
+}
+
+void transformVertices(const float* A, const float* inX, const float* inY, const float* inZ,
+                       size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                       float* outX, float* outY, float* outZ, uint8_t* outcode) {
+    __m512 m[16];
+    for(size_t j = 0; j < 16; j++) m[j] = _mm512_set1_ps(A[j]);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 vWidth = _mm512_set1_ps(width);
+    const __m512 vHeight = _mm512_set1_ps(height);
+    const __m512 vNear = _mm512_set1_ps(-nearPlaneDist);
+    const __m512 vFar = _mm512_set1_ps(farPlaneDist);
+    const __m512i signBit = _mm512_set1_epi32(static_cast<int> (0x80000000u));
+
+    for(size_t i = 0; i < count; i += 16) {
+        __mmask16 lanes = count - i >= 16 ? static_cast<__mmask16> (0xFFFF) : tailMask(count - i);
+        // Inactive lanes load 1 so the divides below stay finite
+        __m512 x = _mm512_mask_loadu_ps(one, lanes, inX + i);
+        __m512 y = _mm512_mask_loadu_ps(one, lanes, inY + i);
+        __m512 z = _mm512_mask_loadu_ps(one, lanes, inZ + i);
+
+        // Multiply and add separately, fused multiply-add would round differently to the scalar path
+        __m512 clipX = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m[0], x), _mm512_mul_ps(m[1], y)), _mm512_mul_ps(m[2], z)), m[3]);
+        __m512 clipY = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m[4], x), _mm512_mul_ps(m[5], y)), _mm512_mul_ps(m[6], z)), m[7]);
+        __m512 clipZ = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m[8], x), _mm512_mul_ps(m[9], y)), _mm512_mul_ps(m[10], z)), m[11]);
+        __m512 clipW = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m[12], x), _mm512_mul_ps(m[13], y)), _mm512_mul_ps(m[14], z)), m[15]);
+        __m512 negW = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(clipW), signBit));
+
+        __m512i code = _mm512_maskz_mov_epi32(_mm512_cmp_ps_mask(clipX, negW, _CMP_LT_OQ), _mm512_set1_epi32(CLIP_LEFT));
+        code = _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(clipX, clipW, _CMP_GT_OQ), code, _mm512_set1_epi32(CLIP_RIGHT));
+        code = _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(clipY, negW, _CMP_LT_OQ), code, _mm512_set1_epi32(CLIP_BOTTOM));
+        code = _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(clipY, clipW, _CMP_GT_OQ), code, _mm512_set1_epi32(CLIP_TOP));
+        code = _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(clipZ, vNear, _CMP_LT_OQ), code, _mm512_set1_epi32(CLIP_NEAR));
+        code = _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(clipZ, vFar, _CMP_GT_OQ), code, _mm512_set1_epi32(CLIP_FAR));
+        _mm512_mask_cvtepi32_storeu_epi8(outcode + i, lanes, code);
+
+        __m512 screenX = _mm512_sub_ps(vWidth, _mm512_mul_ps(_mm512_mul_ps(_mm512_add_ps(_mm512_div_ps(clipX, clipW), one), vWidth), half));
+        __m512 screenY = _mm512_sub_ps(vHeight, _mm512_mul_ps(_mm512_mul_ps(_mm512_add_ps(_mm512_div_ps(clipY, clipW), one), vHeight), half));
+        _mm512_mask_storeu_ps(outX + i, lanes, screenX);
+        _mm512_mask_storeu_ps(outY + i, lanes, screenY);
+        _mm512_mask_storeu_ps(outZ + i, lanes, _mm512_div_ps(clipZ, clipW));
+    }
+}
+
+void rasterSpan(const spanSetup &tri, int y, int xBegin, int xEnd, uint32_t color,
+                uint32_t* colorRow, float* depthRow) {
+    const __m512 v0x = _mm512_set1_ps(tri.v0x);
+    const __m512 negV0y = _mm512_set1_ps(-tri.v0y);
+    const __m512 v1x = _mm512_set1_ps(tri.v1x);
+    const __m512 v1y = _mm512_set1_ps(tri.v1y);
+    const __m512 detInverse = _mm512_set1_ps(tri.detInverse);
+    const __m512 az = _mm512_set1_ps(tri.az);
+    const __m512 bz = _mm512_set1_ps(tri.bz);
+    const __m512 cz = _mm512_set1_ps(tri.cz);
+    const __m512 ax = _mm512_set1_ps(tri.ax);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i vColor = _mm512_set1_epi32(static_cast<int> (color));
+    const __m512 v2y = _mm512_set1_ps((y + 0.5f) - tri.ay);
+    const __m512 laneOffset = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    for(int x = xBegin; x <= xEnd; x += 16) {
+        __mmask16 lanes = xEnd - x >= 15 ? static_cast<__mmask16> (0xFFFF) : tailMask(xEnd - x + 1);
+        __m512 v2x = _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(_mm512_cvtepi32_ps(_mm512_set1_epi32(x)), laneOffset), half), ax);
+        __m512 v = _mm512_mul_ps(detInverse, _mm512_sub_ps(_mm512_mul_ps(v1y, v2x), _mm512_mul_ps(v1x, v2y)));
+        __m512 w = _mm512_mul_ps(detInverse, _mm512_add_ps(_mm512_mul_ps(negV0y, v2x), _mm512_mul_ps(v0x, v2y)));
+        __m512 u = _mm512_sub_ps(_mm512_sub_ps(one, v), w);
+        __m512 depth = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(u, az), _mm512_mul_ps(v, bz)), _mm512_mul_ps(w, cz));
+
+        __mmask16 write = _mm512_mask_cmp_ps_mask(lanes, u, zero, _CMP_GT_OQ);
+        write = _mm512_mask_cmp_ps_mask(write, v, zero, _CMP_GT_OQ);
+        write = _mm512_mask_cmp_ps_mask(write, w, zero, _CMP_GT_OQ);
+        write = _mm512_mask_cmp_ps_mask(write, depth, _mm512_maskz_loadu_ps(lanes, depthRow + x), _CMP_LT_OQ);
+        if(write == 0) continue;
+
+        _mm512_mask_storeu_ps(depthRow + x, write, depth);
+        _mm512_mask_storeu_epi32(colorRow + x, write, vColor);
+    }
+}
+
+void clearFrame(uint32_t* color, float* depth, size_t count, uint32_t clearColor, float clearDepth) {
+    const __m512i vColor = _mm512_set1_epi32(static_cast<int> (clearColor));
+    const __m512 vDepth = _mm512_set1_ps(clearDepth);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        _mm512_storeu_si512(color + i, vColor);
+        _mm512_storeu_ps(depth + i, vDepth);
+    }
+    if(i < count) {
+        _mm512_mask_storeu_epi32(color + i, tailMask(count - i), vColor);
+        _mm512_mask_storeu_ps(depth + i, tailMask(count - i), vDepth);
+    }
+}
+
+void copyFrame(uint8_t* dst, ptrdiff_t dstStride, const uint32_t* src, size_t width, size_t height) {
+    for(size_t y = 0; y < height; y++) {
+        uint32_t* dstRow = reinterpret_cast<uint32_t*> (dst + y * dstStride);
+        const uint32_t* srcRow = src + y * width;
+        for(size_t x = 0; x < width; x += 16) {
+            __mmask16 lanes = width - x >= 16 ? static_cast<__mmask16> (0xFFFF) : tailMask(width - x);
+            _mm512_mask_storeu_epi32(dstRow + x, lanes, _mm512_maskz_loadu_epi32(lanes, srcRow + x));
+        }
+    }
+}
+
+}
+
+const renderKernels avx512Kernels = {
+    kernelIsa::avx512,
+    "AVX-512",
+    transformVertices,
+    rasterSpan,
+    clearFrame,
+    copyFrame
+};
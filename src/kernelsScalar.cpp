@@ -0,0 +1,21 @@
+#include "kernels.hpp"
+#include "kernelsScalar.hpp"
+
+namespace {
+
+void copyFrame(uint8_t* dst, ptrdiff_t dstStride, const uint32_t* src, size_t width, size_t height) {
+    for(size_t y = 0; y < height; y++) {
+        scalarCopyRow(reinterpret_cast<uint32_t*> (dst + y * dstStride), src + y * width, width);
+    }
+}
+
+}
+
+const renderKernels scalarKernels = {
+    kernelIsa::scalar,
+    "scalar",
+    scalarTransformVertices,
+    scalarRasterSpan,
+    scalarClearFrame,
+    copyFrame
+};
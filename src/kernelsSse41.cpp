@@ -0,0 +1,126 @@
+#include <smmintrin.h>
+#include "kernels.hpp"
+#include "kernelsScalar.hpp"
+
+// Built with SSE4.1 enabled, only called when the CPU supports it
+
+namespace {
+
+void transformVertices(const float* A, const float* inX, const float* inY, const float* inZ,
+                       size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                       float* outX, float* outY, float* outZ, uint8_t* outcode) {
+    __m128 m[16];
+    for(size_t j = 0; j < 16; j++) m[j] = _mm_set1_ps(A[j]);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 vWidth = _mm_set1_ps(width);
+    const __m128 vHeight = _mm_set1_ps(height);
+    const __m128 vNear = _mm_set1_ps(-nearPlaneDist);
+    const __m128 vFar = _mm_set1_ps(farPlaneDist);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(inX + i);
+        __m128 y = _mm_loadu_ps(inY + i);
+        __m128 z = _mm_loadu_ps(inZ + i);
+
+        // Multiply and add separately, fused multiply-add would round differently to the scalar path
+        __m128 clipX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_mul_ps(m[2], z)), m[3]);
+        __m128 clipY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)), _mm_mul_ps(m[6], z)), m[7]);
+        __m128 clipZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)), _mm_mul_ps(m[10], z)), m[11]);
+        __m128 clipW = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[12], x), _mm_mul_ps(m[13], y)), _mm_mul_ps(m[14], z)), m[15]);
+        __m128 negW = _mm_xor_ps(clipW, signBit);
+
+        __m128i code = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(clipX, negW)), _mm_set1_epi32(CLIP_LEFT));
+        code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(clipX, clipW)), _mm_set1_epi32(CLIP_RIGHT)));
+        code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(clipY, negW)), _mm_set1_epi32(CLIP_BOTTOM)));
+        code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(clipY, clipW)), _mm_set1_epi32(CLIP_TOP)));
+        code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(clipZ, vNear)), _mm_set1_epi32(CLIP_NEAR)));
+        code = _mm_or_si128(code, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(clipZ, vFar)), _mm_set1_epi32(CLIP_FAR)));
+        __m128i code16 = _mm_packus_epi32(code, code);
+        _mm_storeu_si32(outcode + i, _mm_packus_epi16(code16, code16));
+
+        __m128 screenX = _mm_sub_ps(vWidth, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_div_ps(clipX, clipW), one), vWidth), half));
+        __m128 screenY = _mm_sub_ps(vHeight, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_div_ps(clipY, clipW), one), vHeight), half));
+        _mm_storeu_ps(outX + i, screenX);
+        _mm_storeu_ps(outY + i, screenY);
+        _mm_storeu_ps(outZ + i, _mm_div_ps(clipZ, clipW));
+    }
+
+    scalarTransformVertices(A, inX + i, inY + i, inZ + i, count - i, nearPlaneDist, farPlaneDist, width, height,
+                            outX + i, outY + i, outZ + i, outcode + i);
+}
+
+void rasterSpan(const spanSetup &tri, int y, int xBegin, int xEnd, uint32_t color,
+                uint32_t* colorRow, float* depthRow) {
+    const __m128 v0x = _mm_set1_ps(tri.v0x);
+    const __m128 negV0y = _mm_set1_ps(-tri.v0y);
+    const __m128 v1x = _mm_set1_ps(tri.v1x);
+    const __m128 v1y = _mm_set1_ps(tri.v1y);
+    const __m128 detInverse = _mm_set1_ps(tri.detInverse);
+    const __m128 az = _mm_set1_ps(tri.az);
+    const __m128 bz = _mm_set1_ps(tri.bz);
+    const __m128 cz = _mm_set1_ps(tri.cz);
+    const __m128 ax = _mm_set1_ps(tri.ax);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 vColor = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int> (color)));
+    const __m128 v2y = _mm_set1_ps((y + 0.5f) - tri.ay);
+    const __m128 laneOffset = _mm_setr_ps(0, 1, 2, 3);
+
+    int x = xBegin;
+    for(; x + 3 <= xEnd; x += 4) {
+        __m128 v2x = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_set1_epi32(x)), laneOffset), half), ax);
+        __m128 v = _mm_mul_ps(detInverse, _mm_sub_ps(_mm_mul_ps(v1y, v2x), _mm_mul_ps(v1x, v2y)));
+        __m128 w = _mm_mul_ps(detInverse, _mm_add_ps(_mm_mul_ps(negV0y, v2x), _mm_mul_ps(v0x, v2y)));
+        __m128 u = _mm_sub_ps(_mm_sub_ps(one, v), w);
+        __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, az), _mm_mul_ps(v, bz)), _mm_mul_ps(w, cz));
+
+        __m128 oldDepth = _mm_loadu_ps(depthRow + x);
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+        __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(depth, oldDepth));
+        if(_mm_movemask_ps(write) == 0) continue;
+
+        __m128 oldColor = _mm_loadu_ps(reinterpret_cast<const float*> (colorRow + x));
+        _mm_storeu_ps(depthRow + x, _mm_blendv_ps(oldDepth, depth, write));
+        _mm_storeu_ps(reinterpret_cast<float*> (colorRow + x), _mm_blendv_ps(oldColor, vColor, write));
+    }
+
+    scalarRasterSpan(tri, y, x, xEnd, color, colorRow, depthRow);
+}
+
+void clearFrame(uint32_t* color, float* depth, size_t count, uint32_t clearColor, float clearDepth) {
+    const __m128i vColor = _mm_set1_epi32(static_cast<int> (clearColor));
+    const __m128 vDepth = _mm_set1_ps(clearDepth);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*> (color + i), vColor);
+        _mm_storeu_ps(depth + i, vDepth);
+    }
+    scalarClearFrame(color + i, depth + i, count - i, clearColor, clearDepth);
+}
+
+void copyFrame(uint8_t* dst, ptrdiff_t dstStride, const uint32_t* src, size_t width, size_t height) {
+    for(size_t y = 0; y < height; y++) {
+        uint32_t* dstRow = reinterpret_cast<uint32_t*> (dst + y * dstStride);
+        const uint32_t* srcRow = src + y * width;
+        size_t x = 0;
+        for(; x + 4 <= width; x += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*> (dstRow + x), _mm_loadu_si128(reinterpret_cast<const __m128i*> (srcRow + x)));
+        }
+        scalarCopyRow(dstRow + x, srcRow + x, width - x);
+    }
+}
+
+}
+
+const renderKernels sse41Kernels = {
+    kernelIsa::sse41,
+    "SSE4.1",
+    transformVertices,
+    rasterSpan,
+    clearFrame,
+    copyFrame
+};
@@ -1,10 +1,19 @@
 #include <windows.h>
 #include <objidl.h>
 #include <gdiplus.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <vector>
+#include "chunkCache.hpp"
+#include "compactMesh.hpp"
+#include "frameArena.hpp"
+#include "kernels.hpp"
 #include "screenRender.hpp"
+#include "meshChunks.hpp"
 #include "readObj.hpp"
+#include "reprojection.hpp"
 #pragma comment (lib,"Gdiplus.lib")
 
 constexpr UINT_PTR IDT_TIMER1 = 1;
@@ -12,10 +21,16 @@ constexpr UINT_PTR IDT_TIMER1 = 1;
 struct WindowData {
     Camera camera;
     std::vector<worldTriangle> triangleArray;
-    std::vector<Gdiplus::ARGB> imageArray;
-    std::vector<float> depthBuffer;
+    std::unique_ptr<compactMesh> compact; // Set when drawing the compact encoding, triangleArray is emptied then
+    std::unique_ptr<ChunkCache> chunkCache; // Set when streaming, triangleArray is unused then
+    std::unique_ptr<Reprojector> reprojector; // Set when reusing earlier frames
+    AlignedBuffer<colorARGB> imageArray; // Framebuffers keep their memory across resizes
+    AlignedBuffer<float> depthBuffer;
+    FrameArena frameArena; // Transient per-frame render data
     size_t width;
     size_t height;
+    size_t lastFrameAllocations = SIZE_MAX;
+    float compactPixelError = 0;
     WindowData(const Camera _camera,
                const std::vector<worldTriangle> _triangleArray)
                : camera(_camera),
@@ -24,7 +39,7 @@ struct WindowData {
 
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 
-INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, PSTR, INT iCmdShow) {
+INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, PSTR lpCmdLine, INT iCmdShow) {
     using namespace Gdiplus;
     HWND                hWnd;
     MSG                 msg;
@@ -61,6 +76,19 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, PSTR, INT iCmdShow) {
 
     RegisterRawInputDevices(rawInput, ARRAYSIZE(rawInput), sizeof(rawInput[0]));
 
+    // --kernels=NAME forces the scalar, sse41, avx2 or avx512 kernels for
+    // benchmarking, ignored if the CPU does not support them
+    const char* kernelsArg = std::strstr(lpCmdLine, "--kernels=");
+    if(kernelsArg != nullptr) {
+        char isaName[16] = {};
+        kernelsArg += std::strlen("--kernels=");
+        for(size_t i = 0; i < sizeof(isaName) - 1 && kernelsArg[i] != '\0' && kernelsArg[i] != ' '; i++) {
+            isaName[i] = kernelsArg[i];
+        }
+        kernelIsa isa;
+        if(parseKernelIsa(isaName, isa)) forceKernelIsa(isa);
+    }
+
     // Create camera object at (0,0,5), looking down -Z direction
     Camera camera(0,0,5,
                   0,180,0,
@@ -71,7 +99,47 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, PSTR, INT iCmdShow) {
 
     // To render an image, .obj file must have name model.obj,
     // and be in the same directory as the executable.
-    objToTriangles("model", windowData->triangleArray);
+    // --stream renders from model.chunks instead, made from model.obj
+    // beforehand with chunkConvert. Only visible parts of the model are kept
+    // in memory, up to --cache-mb=N megabytes (default 512).
+    if(std::strstr(lpCmdLine, "--stream") != nullptr) {
+        size_t cacheMegabytes = 512;
+        const char* cacheArg = std::strstr(lpCmdLine, "--cache-mb=");
+        if(cacheArg != nullptr) cacheMegabytes = std::strtoul(cacheArg + std::strlen("--cache-mb="), nullptr, 10);
+
+        windowData->chunkCache = std::make_unique<ChunkCache>("model", cacheMegabytes << 20);
+        if(!windowData->chunkCache->isOpen()) {
+            MessageBox(NULL, TEXT("model.chunks is missing or invalid, create it with: chunkConvert model"),
+                       TEXT("Getting Started"), MB_ICONERROR);
+            delete windowData;
+            GdiplusShutdown(gdiplusToken);
+            return 1;
+        }
+    } else {
+        objToTriangles("model", windowData->triangleArray);
+    }
+
+    // --compact draws from a compact encoding of the model, using about a
+    // third of the memory. The largest position error it causes, in pixels for
+    // geometry at the near plane of a full screen window, is shown in the
+    // window title. Not used with --stream.
+    if(windowData->chunkCache == nullptr && std::strstr(lpCmdLine, "--compact") != nullptr) {
+        windowData->compact = std::make_unique<compactMesh>();
+        buildCompactMesh(windowData->triangleArray, *windowData->compact);
+        compactError error = measureCompactError(windowData->triangleArray, *windowData->compact);
+        windowData->compactPixelError = screenErrorBound(error, camera, GetSystemMetrics(SM_CXSCREEN),
+                                                         GetSystemMetrics(SM_CYSCREEN), camera.getNear());
+        windowData->triangleArray = std::vector<worldTriangle>(); // Release the memory, clear() would keep it
+    }
+
+    // --reproject builds frames from earlier ones, redrawing only what changed,
+    // with a full redraw at least every --refresh-frames=N frames (default 30)
+    if(std::strstr(lpCmdLine, "--reproject") != nullptr) {
+        unsigned int refreshFrames = 30;
+        const char* refreshArg = std::strstr(lpCmdLine, "--refresh-frames=");
+        if(refreshArg != nullptr) refreshFrames = std::strtoul(refreshArg + std::strlen("--refresh-frames="), nullptr, 10);
+        windowData->reprojector = std::make_unique<Reprojector>(refreshFrames);
+    }
 
     hWnd = CreateWindow(
         TEXT("GettingStarted"),   // window class name
@@ -133,6 +201,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message,
         auto& triangles = windowData->triangleArray;
         auto& imageArray = windowData->imageArray;
         auto& depthBuffer = windowData->depthBuffer;
+        auto& frameArena = windowData->frameArena;
+
+        allocStats::beginFrame();
+        frameArena.reset();
 
         RECT rect; // Update image size
         GetClientRect(hWnd, &rect);
@@ -143,11 +215,39 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message,
             windowData->height = rect.bottom;
         }
 
-        renderImage(camera, triangles, rect.right, rect.bottom, imageArray, depthBuffer);
+        if(windowData->chunkCache != nullptr) {
+            renderStreamed(camera, *windowData->chunkCache, rect.right, rect.bottom, imageArray, depthBuffer, frameArena,
+                           windowData->reprojector.get());
+        } else if(windowData->compact != nullptr && windowData->reprojector != nullptr) {
+            renderReprojected(camera, *windowData->reprojector, *windowData->compact, rect.right, rect.bottom, imageArray,
+                              depthBuffer, frameArena);
+        } else if(windowData->compact != nullptr) {
+            renderCompactImage(camera, *windowData->compact, rect.right, rect.bottom, imageArray, depthBuffer, frameArena);
+        } else if(windowData->reprojector != nullptr) {
+            renderReprojected(camera, *windowData->reprojector, triangles, rect.right, rect.bottom, imageArray, depthBuffer,
+                              frameArena);
+        } else {
+            renderImage(camera, triangles, rect.right, rect.bottom, imageArray, depthBuffer, frameArena);
+        }
 
         OnPaint(hdc, rect.right, rect.bottom, imageArray, camera);
 
         EndPaint(hWnd, &ps);
+
+        // Show heap allocations made this frame, should stay at zero once the
+        // arena and framebuffers have grown to fit
+        size_t frameAllocations = allocStats::frameAllocations();
+        if(frameAllocations != windowData->lastFrameAllocations) {
+            char title[160];
+            int length = wsprintfA(title, "Getting Started - %s - %u heap allocs/frame", getKernels().name,
+                                   static_cast<UINT> (frameAllocations));
+            if(windowData->compact != nullptr) { // wsprintf has no floats, show thousandths of a pixel
+                wsprintfA(title + length, " - compact, error <= %u/1000 px",
+                          static_cast<UINT> (std::ceil(windowData->compactPixelError * 1000)));
+            }
+            SetWindowTextA(hWnd, title);
+            windowData->lastFrameAllocations = frameAllocations;
+        }
         }
         return 0;
     case WM_INPUT:
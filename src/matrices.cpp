@@ -1,132 +1,76 @@
 #include <array>
+#include <cmath>
+#include <utility>
+#include "kernels.hpp"
 #include "screenRender.hpp"
 #include "matrices.hpp"
 
-size_t index(size_t col, size_t row) {return col + 4 * row;}
-
-std::array<float,16> matrixMultiply(const std::array<float, 16> &A, const std::array<float, 16> &B) {
-    std::array<float, 16> C;
+// Compile time checks of the matrix builders
+static_assert(matrixVectorMultiply(translationMatrix(1, 2, 3), point4D(1, 1, 1, 1)).z == 4);
+static_assert(matrixVectorMultiply(yawMatrix(1, 0), point4D(1, 0, 0, 1)).z == 1);
+static_assert(matrixVectorMultiply(pitchMatrix(1, 0), point4D(0, 1, 0, 1)).z == 1);
+static_assert(matrixMultiply(translationMatrix(1, 2, 3), translationMatrix(-1, -2, -3)) == translationMatrix(0, 0, 0));
+static_assert(matrixVectorMultiply(perspectiveMatrix(1, 1, 1, 3), point4D(0, 0, 1, 1)).z == -1); // Near plane maps to z = -w
+static_assert(matrixVectorMultiply(perspectiveMatrix(1, 1, 1, 3), point4D(0, 0, 3, 1)).z == 3); // Far plane maps to z = w
+static_assert(matrixVectorMultiply(perspectiveMatrix(1, 1, 1, 3), point4D(0, 0, 3, 1)).w == 3);
+
+bool matrixInverse(const std::array<float, 16> &A, std::array<float, 16> &inverse) {
+    // Gauss-Jordan elimination with partial pivoting, in double as the
+    // projection matrices mix very large and very small terms
+    double work[4][8];
     for(size_t row = 0; row < 4; row++) {
         for(size_t col = 0; col < 4; col++) {
-            float sum = 0.0f;
-            for(size_t p = 0; p < 4; p++) {
-                sum += A[index(p,row)] * B[index(col,p)];
-            }
-            C[index(col,row)] = sum;
+            work[row][col] = A[col + 4 * row];
+            work[row][col + 4] = row == col ? 1.0 : 0.0;
         }
     }
-    return C;
-}
 
-point4D matrixVectorMultiply(const std::array<float, 16> &A, point4D V) {
-    point4D _V;
-    _V.x = A[0] * V.x + A[1] * V.y + A[2] * V.z + A[3] * V.w;
-    _V.y = A[4] * V.x + A[5] * V.y + A[6] * V.z + A[7] * V.w;
-    _V.z = A[8] * V.x + A[9] * V.y + A[10] * V.z + A[11] * V.w;
-    _V.w = A[12] * V.x + A[13] * V.y + A[14] * V.z + A[15] * V.w;
-    return _V;
+    for(size_t col = 0; col < 4; col++) {
+        size_t pivot = col;
+        for(size_t row = col + 1; row < 4; row++) {
+            if(std::fabs(work[row][col]) > std::fabs(work[pivot][col])) pivot = row;
+        }
+        if(work[pivot][col] == 0.0) return false;
+        std::swap(work[pivot], work[col]);
+
+        double scale = 1.0 / work[col][col];
+        for(size_t i = 0; i < 8; i++) work[col][i] *= scale;
+        for(size_t row = 0; row < 4; row++) {
+            if(row == col) continue;
+            double factor = work[row][col];
+            for(size_t i = 0; i < 8; i++) work[row][i] -= factor * work[col][i];
+        }
+    }
+
+    for(size_t row = 0; row < 4; row++) {
+        for(size_t col = 0; col < 4; col++) inverse[col + 4 * row] = static_cast<float> (work[row][col + 4]);
+    }
+    return true;
 }
 
 void cameraToOrigin(Camera &camera, std::array<float, 16> &A) {
     point4D cameraPos = camera.getPos();
-
-    A[0] = 1; //Row 1
-    A[1] = 0;
-    A[2] = 0;
-    A[3] = -cameraPos.x;
-
-    A[4] = 0; //Row 2
-    A[5] = 1;
-    A[6] = 0;
-    A[7] = -cameraPos.y;
-
-    A[8] = 0; //Row 3
-    A[9] = 0;
-    A[10] = 1;
-    A[11] = -cameraPos.z;
-
-    A[12] = 0; //Row 4
-    A[13] = 0;
-    A[14] = 0;
-    A[15] = 1;
+    A = translationMatrix(-cameraPos.x, -cameraPos.y, -cameraPos.z);
 }
 
 void cameraRotateYaw(Camera &camera, std::array<float, 16> &A) {
     float yaw = camera.getYawR();
-    float sinYaw = sin(yaw);
-    float cosYaw = cos(yaw);
-
-    A[0] = cosYaw; //Row 1
-    A[1] = 0;
-    A[2] = -sinYaw;
-    A[3] = 0;
-
-    A[4] = 0; //Row 2
-    A[5] = 1;
-    A[6] = 0;
-    A[7] = 0;
-
-    A[8] = sinYaw; //Row 3
-    A[9] = 0;
-    A[10] = cosYaw;
-    A[11] = 0;
-
-    A[12] = 0; //Row 4
-    A[13] = 0;
-    A[14] = 0;
-    A[15] = 1;
+    A = yawMatrix(sin(yaw), cos(yaw));
 }
 
 void cameraRotatePitch(Camera &camera, std::array<float, 16> &A) {
     float pitch = camera.getPitchR();
-    float sinPitch = sin(pitch);
-    float cosPitch = cos(pitch);
-
-    A[0] = 1; //Row 1
-    A[1] = 0;
-    A[2] = 0;
-    A[3] = 0;
-
-    A[4] = 0; //Row 2
-    A[5] = cosPitch;
-    A[6] = -sinPitch;
-    A[7] = 0;
-
-    A[8] = 0; //Row 3
-    A[9] = sinPitch;
-    A[10] = cosPitch;
-    A[11] = 0;
-
-    A[12] = 0; //Row 4
-    A[13] = 0;
-    A[14] = 0;
-    A[15] = 1;
+    A = pitchMatrix(sin(pitch), cos(pitch));
 }
 
 void cameraToClipSpace(Camera &camera, float aspectRatio, std::array<float, 16> &A) {
-    float nearPlaneDist = camera.getNear();
-    float farPlaneDist = camera.getFar();
-    float fov = camera.getFovR();
-    float tFov = tan(fov * 0.5f); //Near / Right
-
-    A[0] = 1 / tFov; //Row 1
-    A[1] = 0;
-    A[2] = 0;
-    A[3] = 0;
-
-    A[4] = 0; //Row 2
-    A[5] = aspectRatio / (tFov);
-    A[6] = 0;
-    A[7] = 0;
-
-    A[8] = 0; //Row 3
-    A[9] = 0;
-    A[10] = (farPlaneDist + nearPlaneDist) / (farPlaneDist - nearPlaneDist);
-    A[11] = -2 * farPlaneDist * nearPlaneDist / (farPlaneDist - nearPlaneDist);
-
-    A[12] = 0; //Row 4
-    A[13] = 0;
-    A[14] = 1;
-    A[15] = 0;
+    float tFov = tan(camera.getFovR() * 0.5f); //Near / Right
+    A = perspectiveMatrix(tFov, aspectRatio, camera.getNear(), camera.getFar());
 }
 
+void transformVerticesToScreen(const std::array<float, 16> &A, const float* inX, const float* inY, const float* inZ,
+                               size_t count, float nearPlaneDist, float farPlaneDist, float width, float height,
+                               float* outX, float* outY, float* outZ, uint8_t* outcode) {
+    getKernels().transformVertices(A.data(), inX, inY, inZ, count, nearPlaneDist, farPlaneDist, width, height,
+                                   outX, outY, outZ, outcode);
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "meshChunks.hpp"
+#include "screenRender.hpp"
+
+static_assert(sizeof(chunkFileHeader) == 40, "chunkFileHeader is written to disk as is");
+static_assert(sizeof(chunkInfo) == 40, "chunkInfo is written to disk as is");
+
+namespace {
+
+// Triangles buffered per chunk before being written out when converting
+constexpr size_t WRITE_BATCH_TRIANGLES = 64;
+
+// Cells per side of the grid triangles are counted in when converting, a
+// power of two. Chunks are built from octree nodes over this grid.
+constexpr int COUNT_GRID_DIM = 64;
+
+// Load the three vertex positions of a face line into tri, returns false
+// if the line is not a face or references a missing vertex
+bool parseFace(const std::string &line, const std::vector<float> &positions, float tri[9]) {
+    if(!line.starts_with("f ")) return false;
+    int vert[3];
+    char prefix;
+    std::istringstream ss(line);
+    if(!(ss >> prefix >> vert[0] >> vert[1] >> vert[2])) return false;
+
+    size_t vertexCount = positions.size() / 3;
+    for(size_t i = 0; i < 3; i++) {
+        if(vert[i] < 1 || static_cast<size_t> (vert[i]) > vertexCount) return false;
+        std::memcpy(tri + 3 * i, &positions[3 * (vert[i] - 1)], 3 * sizeof(float));
+    }
+    return true;
+}
+
+// Grid cell containing the centroid of tri
+size_t cellIndex(const float tri[9], const float boundsMin[3], const float boundsMax[3], int gridDim) {
+    size_t cell = 0;
+    for(int axis = 2; axis >= 0; axis--) {
+        float centroid = (tri[axis] + tri[axis + 3] + tri[axis + 6]) / 3.0f;
+        float extent = boundsMax[axis] - boundsMin[axis];
+        int i = extent > 0 ? static_cast<int> ((centroid - boundsMin[axis]) / extent * gridDim) : 0;
+        cell = cell * gridDim + std::clamp(i, 0, gridDim - 1);
+    }
+    return cell;
+}
+
+void expandBounds(float boundsMin[3], float boundsMax[3], const float* point) {
+    for(size_t axis = 0; axis < 3; axis++) {
+        boundsMin[axis] = std::min(boundsMin[axis], point[axis]);
+        boundsMax[axis] = std::max(boundsMax[axis], point[axis]);
+    }
+}
+
+size_t gridIndex(size_t x, size_t y, size_t z, size_t dim) {
+    return (z * dim + y) * dim + x;
+}
+
+// Splits the count grid into chunks top down. countLevels[0] is the count
+// grid and each level after it halves the cells per side, down to a single
+// cell. A node with at most maxTriangles triangles becomes one chunk, a
+// fuller one is split into its eight children. A single grid cell that is
+// still too full is cut into several chunks by triangle order. cellChunk
+// receives the first chunk of each grid cell.
+void splitNode(const std::vector<std::vector<uint64_t>> &countLevels, size_t level, size_t x, size_t y, size_t z,
+               uint32_t maxTriangles, std::vector<chunkInfo> &chunks, std::vector<uint32_t> &cellChunk) {
+    size_t dim = COUNT_GRID_DIM >> level;
+    uint64_t count = countLevels[level][gridIndex(x, y, z, dim)];
+    if(count == 0) return;
+
+    if(count > maxTriangles && level > 0) {
+        for(size_t child = 0; child < 8; child++) {
+            splitNode(countLevels, level - 1, 2 * x + (child & 1), 2 * y + ((child >> 1) & 1), 2 * z + (child >> 2),
+                      maxTriangles, chunks, cellChunk);
+        }
+        return;
+    }
+
+    uint32_t first = static_cast<uint32_t> (chunks.size());
+    for(uint64_t done = 0; done < count; done += maxTriangles) {
+        chunkInfo chunk;
+        std::fill(chunk.boundsMin, chunk.boundsMin + 3, FLT_MAX);
+        std::fill(chunk.boundsMax, chunk.boundsMax + 3, -FLT_MAX);
+        chunk.offset = 0;
+        chunk.triangleCount = static_cast<uint32_t> (std::min<uint64_t>(maxTriangles, count - done));
+        chunk.reserved = 0;
+        chunks.push_back(chunk);
+    }
+
+    size_t cells = size_t(1) << level; // Grid cells per side of this node
+    for(size_t cz = z * cells; cz < (z + 1) * cells; cz++) {
+        for(size_t cy = y * cells; cy < (y + 1) * cells; cy++) {
+            for(size_t cx = x * cells; cx < (x + 1) * cells; cx++) {
+                cellChunk[gridIndex(cx, cy, cz, COUNT_GRID_DIM)] = first;
+            }
+        }
+    }
+}
+
+}
+
+bool objToChunks(std::string filename, uint32_t maxChunkTriangles) {
+    std::ifstream model(filename + ".obj");
+    if(!model || maxChunkTriangles == 0) return false;
+
+    chunkFileHeader header;
+    std::memcpy(header.magic, CHUNK_FILE_MAGIC, sizeof(header.magic));
+    header.version = CHUNK_FILE_VERSION;
+    std::fill(header.boundsMin, header.boundsMin + 3, FLT_MAX);
+    std::fill(header.boundsMax, header.boundsMax + 3, -FLT_MAX);
+
+    // First pass, load vertex positions and find the model bounds
+    std::vector<float> positions;
+    std::string line;
+    while(std::getline(model, line)) {
+        if(line.starts_with("v ")) {
+            float v[3];
+            char prefix;
+            std::istringstream ss(line);
+            ss >> prefix >> v[0] >> v[1] >> v[2];
+            positions.insert(positions.end(), v, v + 3);
+            expandBounds(header.boundsMin, header.boundsMax, v);
+        }
+    }
+
+    // Second pass, count the triangles in each grid cell, then sum the
+    // counts into coarser levels for splitting
+    std::vector<std::vector<uint64_t>> countLevels(1, std::vector<uint64_t>(gridIndex(0, 0, COUNT_GRID_DIM, COUNT_GRID_DIM)));
+    model.clear();
+    model.seekg(0);
+    float tri[9];
+    while(std::getline(model, line)) {
+        if(!parseFace(line, positions, tri)) continue;
+        countLevels[0][cellIndex(tri, header.boundsMin, header.boundsMax, COUNT_GRID_DIM)]++;
+    }
+    for(size_t dim = COUNT_GRID_DIM / 2; dim >= 1; dim /= 2) {
+        const std::vector<uint64_t> &finer = countLevels.back();
+        std::vector<uint64_t> coarser(dim * dim * dim);
+        for(size_t z = 0; z < 2 * dim; z++) {
+            for(size_t y = 0; y < 2 * dim; y++) {
+                for(size_t x = 0; x < 2 * dim; x++) {
+                    coarser[gridIndex(x / 2, y / 2, z / 2, dim)] += finer[gridIndex(x, y, z, 2 * dim)];
+                }
+            }
+        }
+        countLevels.push_back(std::move(coarser));
+    }
+
+    std::vector<chunkInfo> chunks;
+    std::vector<uint32_t> cellChunk(countLevels[0].size());
+    splitNode(countLevels, countLevels.size() - 1, 0, 0, 0, maxChunkTriangles, chunks, cellChunk);
+    countLevels = std::vector<std::vector<uint64_t>>();
+    header.chunkCount = static_cast<uint32_t> (chunks.size());
+
+    // Chunks are laid out one after another after the table
+    uint64_t offset = sizeof(chunkFileHeader) + chunks.size() * sizeof(chunkInfo);
+    for(chunkInfo &chunk : chunks) {
+        chunk.offset = offset;
+        offset += chunk.triangleCount * CHUNK_TRIANGLE_BYTES;
+    }
+
+    // Written to a temporary file that replaces the .chunks file once
+    // complete, so a failed conversion never leaves a partial file behind
+    std::string path = filename + ".chunks";
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if(!out) return false;
+
+    // Third pass, write each triangle to its chunk through a small buffer per
+    // chunk, bounding the chunks on the way
+    std::vector<std::vector<float>> buffers(chunks.size());
+    std::vector<uint64_t> cursors(chunks.size());
+    for(size_t i = 0; i < chunks.size(); i++) cursors[i] = chunks[i].offset;
+    std::vector<uint32_t> cellTriangles(cellChunk.size()); // Triangles written per grid cell so far
+
+    auto flush = [&](size_t chunk) {
+        std::vector<float> &buffer = buffers[chunk];
+        out.seekp(cursors[chunk]);
+        out.write(reinterpret_cast<const char*> (buffer.data()), buffer.size() * sizeof(float));
+        cursors[chunk] += buffer.size() * sizeof(float);
+        buffer.clear();
+    };
+
+    model.clear();
+    model.seekg(0);
+    while(std::getline(model, line)) {
+        if(!parseFace(line, positions, tri)) continue;
+        size_t cell = cellIndex(tri, header.boundsMin, header.boundsMax, COUNT_GRID_DIM);
+        size_t chunk = cellChunk[cell] + cellTriangles[cell]++ / maxChunkTriangles;
+        for(size_t i = 0; i < 3; i++) expandBounds(chunks[chunk].boundsMin, chunks[chunk].boundsMax, tri + 3 * i);
+        buffers[chunk].insert(buffers[chunk].end(), tri, tri + 9);
+        if(buffers[chunk].size() >= WRITE_BATCH_TRIANGLES * 9) flush(chunk);
+    }
+    for(size_t i = 0; i < chunks.size(); i++) {
+        if(!buffers[i].empty()) flush(i);
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*> (&header), sizeof(header));
+    out.write(reinterpret_cast<const char*> (chunks.data()), chunks.size() * sizeof(chunkInfo));
+    out.close();
+
+    std::error_code error;
+    if(out) std::filesystem::rename(tempPath, path, error);
+    if(!out || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool readChunkTable(std::ifstream &file, chunkFileHeader &header, std::vector<chunkInfo> &chunks) {
+    file.seekg(0);
+    if(!file.read(reinterpret_cast<char*> (&header), sizeof(header))) return false;
+    if(std::memcmp(header.magic, CHUNK_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CHUNK_FILE_VERSION) return false;
+
+    // Reject files cut short before allocating anything, the table and every
+    // chunk's triangles must be in the file
+    file.seekg(0, std::ios::end);
+    uint64_t fileBytes = static_cast<uint64_t> (file.tellg());
+    if(sizeof(chunkFileHeader) + static_cast<uint64_t> (header.chunkCount) * sizeof(chunkInfo) > fileBytes) return false;
+
+    chunks.resize(header.chunkCount);
+    file.seekg(sizeof(chunkFileHeader));
+    if(!file.read(reinterpret_cast<char*> (chunks.data()), chunks.size() * sizeof(chunkInfo))) return false;
+    for(const chunkInfo &chunk : chunks) {
+        if(chunk.offset > fileBytes || chunk.triangleCount * CHUNK_TRIANGLE_BYTES > fileBytes - chunk.offset) return false;
+    }
+    return true;
+}
+
+bool readChunkTriangles(std::ifstream &file, const chunkInfo &chunk, std::vector<worldTriangle> &triangleArray) {
+    constexpr size_t BATCH = 256;
+    float data[BATCH * 9];
+
+    triangleArray.clear();
+    triangleArray.reserve(chunk.triangleCount);
+    file.seekg(chunk.offset);
+    for(size_t done = 0; done < chunk.triangleCount; done += BATCH) {
+        size_t count = std::min<size_t>(BATCH, chunk.triangleCount - done);
+        if(!file.read(reinterpret_cast<char*> (data), count * CHUNK_TRIANGLE_BYTES)) return false;
+        for(size_t i = 0; i < count; i++) {
+            const float* tri = data + 9 * i;
+            triangleArray.emplace_back(point4D(tri[0], tri[1], tri[2], 1),
+                                       point4D(tri[3], tri[4], tri[5], 1),
+                                       point4D(tri[6], tri[7], tri[8], 1));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,555 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "frameArena.hpp"
+#include "kernels.hpp"
+#include "matrices.hpp"
+#include "reprojection.hpp"
+#include "screenRender.hpp"
+
+namespace {
+
+constexpr colorARGB CLEAR_COLOR = 0xFF000000;
+constexpr float CLEAR_DEPTH = 1.0f; // Far plane, also the depth of background pixels
+constexpr float HOLE_DEPTH = 2.0f; // Behind the far plane, marks pixels nothing was warped to
+constexpr float SURFACE_DEPTH_STEP = 0.03f; // Largest relative depth change between neighbouring pixels of one surface
+constexpr float MAX_SPLAT_SIZE = 2.0f; // Widest a warped pixel is drawn, in pixels, before its tile is redrawn instead
+constexpr float MIN_RAY_W = 1e-4f; // Smallest reference w a ray is followed to, just in front of the camera
+constexpr uint8_t COARSE_TILE = 2; // Dirty tile value for tiles the warp spread too thinly, kept even without holes
+// What _fillBackground knows of a hole
+constexpr uint8_t HOLE_UNCHECKED = 0; // Looks up background, ray not followed yet
+constexpr uint8_t HOLE_SEEN = 1; // The reference saw along its ray to the background
+constexpr uint8_t HOLE_UNFILLABLE = 2; // Left for redrawing
+
+// Floor of a value well inside the range of int, without a library call
+int floorToInt(float value) {
+    int truncated = static_cast<int> (value);
+    return truncated - (value < truncated);
+}
+
+// Matrix from pixel coordinates and depth to normalized device coordinates,
+// the inverse of the vertex transform's viewport mapping
+std::array<float, 16> pixelToNdcMatrix(size_t width, size_t height) {
+    return {-2.0f / width, 0, 0, 1,
+            0, -2.0f / height, 0, 1,
+            0, 0, 1, 0,
+            0, 0, 0, 1};
+}
+
+// Turn a matrix from one view's normalized device coordinates to another's
+// clip space into one from pixel coordinates and depth to the other view's
+// homogeneous pixel coordinates, using the vertex transform's viewport mapping
+std::array<float, 16> pixelReprojectionMatrix(const std::array<float, 16> &R, size_t width, size_t height) {
+    float halfWidth = width * 0.5f, halfHeight = height * 0.5f;
+    std::array<float, 16> toViewport = {-halfWidth, 0, 0, halfWidth,
+                                        0, -halfHeight, 0, halfHeight,
+                                        0, 0, 1, 0,
+                                        0, 0, 0, 1};
+    std::array<float, 16> fromViewport = {-1 / halfWidth, 0, 0, 1,
+                                          0, -1 / halfHeight, 0, 1,
+                                          0, 0, 1, 0,
+                                          0, 0, 0, 1};
+    return matrixMultiply(toViewport, matrixMultiply(R, fromViewport));
+}
+
+}
+
+Reprojector::Reprojector(unsigned int _refreshInterval, float _maxDirtyFraction) :
+    referenceM {}, referenceInverse {}, nearestReferenceDepth(CLEAR_DEPTH), combinedM {}, width(0), height(0), tilesX(0), tilesY(0), dirtyTiles(0),
+    refreshInterval(_refreshInterval), framesSinceRefresh(0), maxDirtyFraction(_maxDirtyFraction),
+    valid(false), fullRedraw(true) {}
+
+void Reprojector::reproject(const std::array<float, 16> &_combinedM, size_t _width, size_t _height,
+                            AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer) {
+    combinedM = _combinedM;
+    if(_width != width || _height != height) {
+        width = _width;
+        height = _height;
+        tilesX = (width + REDRAW_TILE_SIZE - 1) / REDRAW_TILE_SIZE;
+        tilesY = (height + REDRAW_TILE_SIZE - 1) / REDRAW_TILE_SIZE;
+        referenceColor.resize(width * height);
+        referenceDepth.resize(width * height);
+        dirty.resize(tilesX * tilesY);
+        valid = false;
+    }
+
+    fullRedraw = !valid || framesSinceRefresh + 1 >= refreshInterval;
+    if(fullRedraw) return;
+
+    colorARGB* pixels = imageArr.data();
+    float* depths = depthBuffer.data();
+    if(combinedM == referenceM) { // Camera has not moved since the reference
+        std::memcpy(pixels, referenceColor.data(), width * height * sizeof(colorARGB));
+        std::memcpy(depths, referenceDepth.data(), width * height * sizeof(float));
+        std::fill(dirty.begin(), dirty.end(), 0);
+        for(const std::array<float, 6> &box : staleBoxes) _markBox(box);
+        return;
+    }
+
+    getKernels().clearFrame(pixels, depths, width * height, CLEAR_COLOR, HOLE_DEPTH);
+    std::fill(dirty.begin(), dirty.end(), 0);
+    _warpReference(pixels, depths);
+
+    // Tiles with holes need redrawing, unless filling cracks and background
+    // closes them all. Cracks go first, gaps in surfaces that grew would
+    // otherwise be filled with whatever background was behind them. Tiles
+    // the warp marked coarse are redrawn either way.
+    for(size_t tileY = 0; tileY < tilesY; tileY++) {
+        for(size_t tileX = 0; tileX < tilesX; tileX++) {
+            uint8_t &tile = dirty[tileX + tilesX * tileY];
+            if(!tile) tile = _tileHasHole(tileX, tileY, depths);
+        }
+    }
+    _fillCracks(pixels, depths);
+    _fillBackground(pixels, depths);
+    for(size_t tileY = 0; tileY < tilesY; tileY++) {
+        for(size_t tileX = 0; tileX < tilesX; tileX++) {
+            uint8_t &tile = dirty[tileX + tilesX * tileY];
+            if(tile == 1) tile = _tileHasHole(tileX, tileY, depths);
+        }
+    }
+    _markUnseenTiles(depths);
+    for(const std::array<float, 6> &box : staleBoxes) _markBox(box);
+}
+
+void Reprojector::markStale(const float boundsMin[3], const float boundsMax[3]) {
+    std::array<float, 6> box = {boundsMin[0], boundsMin[1], boundsMin[2], boundsMax[0], boundsMax[1], boundsMax[2]};
+    staleBoxes.push_back(box);
+    if(!fullRedraw) _markBox(box);
+}
+
+bool Reprojector::boxNeedsRedraw(const float boundsMin[3], const float boundsMax[3]) const {
+    if(fullRedraw) return true;
+    std::array<float, 6> box = {boundsMin[0], boundsMin[1], boundsMin[2], boundsMax[0], boundsMax[1], boundsMax[2]};
+    size_t firstX, lastX, firstY, lastY;
+    if(!_boxTiles(box, firstX, lastX, firstY, lastY)) return false;
+    for(size_t tileY = firstY; tileY <= lastY; tileY++) {
+        for(size_t tileX = firstX; tileX <= lastX; tileX++) {
+            if(dirty[tileX + tilesX * tileY]) return true;
+        }
+    }
+    return false;
+}
+
+bool Reprojector::_boxTiles(const std::array<float, 6> &box, size_t &firstX, size_t &lastX,
+                            size_t &firstY, size_t &lastY) const {
+    float left = static_cast<float> (width), right = -1, top = static_cast<float> (height), bottom = -1;
+    for(int corner = 0; corner < 8; corner++) {
+        point4D p(box[(corner & 1) ? 3 : 0], box[(corner & 2) ? 4 : 1], box[(corner & 4) ? 5 : 2], 1);
+        p = matrixVectorMultiply(combinedM, p);
+        if(p.w <= 0) { // Box reaches behind the camera, its screen bounds are unknown
+            left = top = 0;
+            right = width - 1.0f;
+            bottom = height - 1.0f;
+            break;
+        }
+        float x = width - (p.x / p.w + 1.0f) * width * 0.5f; // Same mapping as the vertex transform
+        float y = height - (p.y / p.w + 1.0f) * height * 0.5f;
+        left = std::min(left, x);
+        right = std::max(right, x);
+        top = std::min(top, y);
+        bottom = std::max(bottom, y);
+    }
+    if(right < 0 || bottom < 0 || left >= width || top >= height) return false;
+
+    firstX = static_cast<size_t> (std::max(left, 0.0f)) / REDRAW_TILE_SIZE;
+    lastX = static_cast<size_t> (std::min(right, width - 1.0f)) / REDRAW_TILE_SIZE;
+    firstY = static_cast<size_t> (std::max(top, 0.0f)) / REDRAW_TILE_SIZE;
+    lastY = static_cast<size_t> (std::min(bottom, height - 1.0f)) / REDRAW_TILE_SIZE;
+    return true;
+}
+
+void Reprojector::_markBox(const std::array<float, 6> &box) {
+    size_t firstX, lastX, firstY, lastY;
+    if(!_boxTiles(box, firstX, lastX, firstY, lastY)) return;
+    for(size_t tileY = firstY; tileY <= lastY; tileY++) {
+        for(size_t tileX = firstX; tileX <= lastX; tileX++) dirty[tileX + tilesX * tileY] = 1;
+    }
+}
+
+void Reprojector::_markUnseenTiles(const float* depths) {
+    // The space a tile shows, from the near plane back to its farthest warped
+    // pixel, is the box between its corners at those depths. Anything in it
+    // is in front of the warped surfaces, so if part of it was outside the
+    // reference view, geometry there could be missing with no hole to show it.
+    // Points are taken from pixel coordinates to the reference's clip space.
+    std::array<float, 16> inverse;
+    if(!matrixInverse(combinedM, inverse)) {
+        std::fill(dirty.begin(), dirty.end(), 1);
+        return;
+    }
+    std::array<float, 16> T = matrixMultiply(referenceM, matrixMultiply(inverse, pixelToNdcMatrix(width, height)));
+
+    // Tolerance of a pixel, so tiles along screen edges the camera moved
+    // away from are not marked from rounding alone. The reference's near and
+    // far planes are not checked, as any turn moves part of the new near
+    // plane in front of the old one, which would mark most of the screen.
+    float edgeScale = 1.0f + 2.0f / std::min(width, height);
+    auto outsideReference = [&](float x, float y, float depth) {
+        point4D p = matrixVectorMultiply(T, point4D(x, y, depth, 1));
+        float limit = p.w * edgeScale;
+        return p.w <= 0 || p.x < -limit || p.x > limit || p.y < -limit || p.y > limit;
+    };
+
+    for(size_t tileY = 0; tileY < tilesY; tileY++) {
+        for(size_t tileX = 0; tileX < tilesX; tileX++) {
+            uint8_t &tile = dirty[tileX + tilesX * tileY];
+            if(tile) continue;
+            size_t x0 = tileX * REDRAW_TILE_SIZE, x1 = std::min(x0 + REDRAW_TILE_SIZE, width);
+            size_t y0 = tileY * REDRAW_TILE_SIZE, y1 = std::min(y0 + REDRAW_TILE_SIZE, height);
+            float farthest = -1.0f;
+            for(size_t y = y0; y < y1; y++) {
+                farthest = std::max(farthest, *std::max_element(depths + width * y + x0, depths + width * y + x1));
+            }
+
+            for(int corner = 0; corner < 8 && !tile; corner++) {
+                tile = outsideReference(static_cast<float> ((corner & 1) ? x1 : x0), static_cast<float> ((corner & 2) ? y1 : y0),
+                                        (corner & 4) ? farthest : -1.0f);
+            }
+        }
+    }
+}
+
+bool Reprojector::_tileHasHole(size_t tileX, size_t tileY, const float* depths) const {
+    size_t x0 = tileX * REDRAW_TILE_SIZE, x1 = std::min(x0 + REDRAW_TILE_SIZE, width);
+    size_t y0 = tileY * REDRAW_TILE_SIZE, y1 = std::min(y0 + REDRAW_TILE_SIZE, height);
+    for(size_t y = y0; y < y1; y++) {
+        const float* row = depths + width * y;
+        if(std::find(row + x0, row + x1, HOLE_DEPTH) != row + x1) return true;
+    }
+    return false;
+}
+
+const uint8_t* Reprojector::prepareRedraw(AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer) {
+    dirtyTiles = fullRedraw ? getTileCount() : getTileCount() - static_cast<size_t> (std::count(dirty.begin(), dirty.end(), 0));
+    if(dirtyTiles > maxDirtyFraction * getTileCount()) fullRedraw = true;
+
+    if(fullRedraw) {
+        dirtyTiles = getTileCount();
+        std::fill(dirty.begin(), dirty.end(), 1);
+        clearImage(width, height, imageArr, depthBuffer);
+        return nullptr;
+    }
+
+    const renderKernels &kernels = getKernels();
+    for(size_t y = 0; y < height; y++) { // Clear each run of dirty tiles a row at a time
+        const uint8_t* tileRow = dirty.data() + (y / REDRAW_TILE_SIZE) * tilesX;
+        for(size_t tile = 0; tile < tilesX; tile++) {
+            if(!tileRow[tile]) continue;
+            size_t runStart = tile;
+            while(tile + 1 < tilesX && tileRow[tile + 1]) tile++;
+            size_t x0 = runStart * REDRAW_TILE_SIZE, x1 = std::min((tile + 1) * REDRAW_TILE_SIZE, width);
+            kernels.clearFrame(imageArr.data() + width * y + x0, depthBuffer.data() + width * y + x0, x1 - x0,
+                               CLEAR_COLOR, CLEAR_DEPTH);
+        }
+    }
+    return dirty.data();
+}
+
+void Reprojector::finishFrame(const AlignedBuffer<colorARGB> &imageArr, const AlignedBuffer<float> &depthBuffer) {
+    if(!fullRedraw) {
+        framesSinceRefresh++;
+        return;
+    }
+
+    referenceM = combinedM;
+    valid = matrixInverse(combinedM, referenceInverse);
+    std::memcpy(referenceColor.data(), imageArr.data(), width * height * sizeof(colorARGB));
+    std::memcpy(referenceDepth.data(), depthBuffer.data(), width * height * sizeof(float));
+    nearestReferenceDepth = *std::min_element(referenceDepth.begin(), referenceDepth.end());
+    staleBoxes.clear();
+    framesSinceRefresh = 0;
+}
+
+void Reprojector::_warpReference(colorARGB* pixels, float* depths) {
+    // Reference pixels go back to world space with the reference's inverse
+    // matrix and forward with the new one. Background is left for
+    // _fillBackground, as spread out background pixels would land in the gaps
+    // of surfaces that grew and hide them from _fillCracks.
+    std::array<float, 16> T = pixelReprojectionMatrix(matrixMultiply(combinedM, referenceInverse), width, height);
+    // The w of a reference pixel's world position is one over its view depth,
+    // neighbours whose w differs by more than SURFACE_DEPTH_STEP of it are
+    // taken to be on different surfaces
+    std::array<float, 16> toWorld = matrixMultiply(referenceInverse, pixelToNdcMatrix(width, height));
+
+    // Rows are warped one ahead of the row being drawn, so each pixel can be
+    // drawn over the area between it and its warped neighbours
+    warpRows.resize(3 * width);
+    auto warpRow = [&](size_t y, warpedPixel* row) {
+        float pixelY = y + 0.5f;
+        float rowX = T[1] * pixelY + T[3], rowY = T[5] * pixelY + T[7];
+        float rowZ = T[9] * pixelY + T[11], rowW = T[13] * pixelY + T[15];
+        float rowWorldW = toWorld[13] * pixelY + toWorld[15];
+        const float* depthRow = referenceDepth.data() + width * y;
+        for(size_t x = 0; x < width; x++) {
+            warpedPixel &warped = row[x];
+            warped.inverseDepth = 0; // Not drawn
+            float depth = depthRow[x];
+            if(depth >= CLEAR_DEPTH) continue;
+            float pixelX = x + 0.5f;
+
+            float w = T[12] * pixelX + T[14] * depth + rowW;
+            if(w <= 0) continue; // Now behind the camera
+            float wInverse = 1 / w;
+            warped.x = (T[0] * pixelX + T[2] * depth + rowX) * wInverse;
+            warped.y = (T[4] * pixelX + T[6] * depth + rowY) * wInverse;
+            warped.depth = (T[8] * pixelX + T[10] * depth + rowZ) * wInverse;
+            if(warped.depth >= CLEAR_DEPTH || warped.depth < -1) continue; // Moved past the far or near plane
+            warped.inverseDepth = toWorld[12] * pixelX + toWorld[14] * depth + rowWorldW;
+        }
+    };
+
+    // Offset from a warped pixel to a neighbour, if both are on the same surface
+    auto neighbourOffset = [](const warpedPixel &from, const warpedPixel &to, float &dx, float &dy) {
+        if(to.inverseDepth <= 0 || std::fabs(to.inverseDepth - from.inverseDepth) > SURFACE_DEPTH_STEP * from.inverseDepth) {
+            return false;
+        }
+        dx = to.x - from.x;
+        dy = to.y - from.y;
+        return true;
+    };
+
+    warpedPixel* above = nullptr;
+    warpedPixel* current = warpRows.data();
+    warpedPixel* below = warpRows.data() + width;
+    warpRow(0, current);
+    for(size_t y = 0; y < height; y++) {
+        if(y + 1 < height) warpRow(y + 1, below);
+        const colorARGB* colorRow = referenceColor.data() + width * y;
+        for(size_t x = 0; x < width; x++) {
+            const warpedPixel &warped = current[x];
+            if(warped.inverseDepth <= 0) continue;
+            // Footprints are at most MAX_SPLAT_SIZE across, so these cannot reach the screen
+            if(!(warped.x > -MAX_SPLAT_SIZE && warped.x < width + MAX_SPLAT_SIZE &&
+                 warped.y > -MAX_SPLAT_SIZE && warped.y < height + MAX_SPLAT_SIZE)) continue;
+
+            // Footprint from the offsets to the neighbours across and down,
+            // or the ones before if those are on another surface. With only
+            // one, the other is taken as it turned a quarter.
+            float acrossX, acrossY, downX, downY;
+            bool across = (x + 1 < width && neighbourOffset(warped, current[x + 1], acrossX, acrossY)) ||
+                          (x > 0 && neighbourOffset(current[x - 1], warped, acrossX, acrossY));
+            bool down = (y + 1 < height && neighbourOffset(warped, below[x], downX, downY)) ||
+                        (above != nullptr && neighbourOffset(above[x], warped, downX, downY));
+            if(across && !down) {
+                downX = -acrossY;
+                downY = acrossX;
+            } else if(down && !across) {
+                acrossX = downY;
+                acrossY = -downX;
+            } else if(!across) {
+                acrossX = downY = 1;
+                acrossY = downX = 0;
+            }
+            float sizeX = std::max(std::fabs(acrossX), std::fabs(downX));
+            float sizeY = std::max(std::fabs(acrossY), std::fabs(downY));
+            if(!(sizeX <= MAX_SPLAT_SIZE && sizeY <= MAX_SPLAT_SIZE)) { // Too spread out to fill, redraw the tile
+                if(warped.x >= 0 && warped.x < width && warped.y >= 0 && warped.y < height) {
+                    dirty[static_cast<size_t> (warped.x) / REDRAW_TILE_SIZE +
+                          tilesX * (static_cast<size_t> (warped.y) / REDRAW_TILE_SIZE)] = COARSE_TILE;
+                }
+                sizeX = sizeY = 1;
+            }
+
+            // Pixels whose centres are in the footprint, and always the one
+            // the warped centre is in
+            int centreX = floorToInt(warped.x), centreY = floorToInt(warped.y);
+            int firstX = std::min(-floorToInt(0.5f * sizeX + 0.5f - warped.x), centreX);
+            int lastX = std::max(-floorToInt(0.5f - 0.5f * sizeX - warped.x) - 1, centreX);
+            int firstY = std::min(-floorToInt(0.5f * sizeY + 0.5f - warped.y), centreY);
+            int lastY = std::max(-floorToInt(0.5f - 0.5f * sizeY - warped.y) - 1, centreY);
+            firstX = std::max(firstX, 0);
+            lastX = std::min(lastX, static_cast<int> (width) - 1);
+            firstY = std::max(firstY, 0);
+            lastY = std::min(lastY, static_cast<int> (height) - 1);
+            for(int targetY = firstY; targetY <= lastY; targetY++) {
+                for(int targetX = firstX; targetX <= lastX; targetX++) {
+                    size_t target = static_cast<size_t> (targetX) + width * static_cast<size_t> (targetY);
+                    if(warped.depth < depths[target]) {
+                        pixels[target] = colorRow[x];
+                        depths[target] = warped.depth;
+                    }
+                }
+            }
+        }
+
+        warpedPixel* next = above != nullptr ? above : warpRows.data() + 2 * width;
+        above = current;
+        current = below;
+        below = next;
+    }
+}
+
+void Reprojector::_fillBackground(colorARGB* pixels, float* depths) {
+    // Background is at the far plane, so each pixel still empty can be looked
+    // up in the reference directly. It is background if that pixel was.
+    // That only holds if the reference saw all the way along the ray to the
+    // background. Holes where part of the ray was hidden behind a reference
+    // surface, such as gaps in surfaces that grew or space that was behind
+    // something now out of view, are left for redrawing.
+    std::array<float, 16> inverse;
+    if(!matrixInverse(combinedM, inverse)) return;
+    std::array<float, 16> T = pixelReprojectionMatrix(matrixMultiply(referenceM, inverse), width, height);
+
+    // Each hole looks up the reference pixel its ray ends at, those that are
+    // not background can not be filled
+    holeStates.resize(width * height);
+    holeSources.resize(width * height);
+    for(size_t y = 0; y < height; y++) {
+        float pixelY = y + 0.5f;
+        float rowX = T[1] * pixelY + T[2] + T[3], rowY = T[5] * pixelY + T[6] + T[7], rowW = T[13] * pixelY + T[14] + T[15];
+        for(size_t x = 0; x < width; x++) {
+            size_t i = x + width * y;
+            if(depths[i] != HOLE_DEPTH) continue;
+            float pixelX = x + 0.5f;
+            float w = T[12] * pixelX + rowW;
+            holeStates[i] = HOLE_UNFILLABLE;
+            if(w <= 0) continue;
+            float wInverse = 1 / w;
+            float sourceX = (T[0] * pixelX + rowX) * wInverse, sourceY = (T[4] * pixelX + rowY) * wInverse;
+            if(!(sourceX >= 0 && sourceX < width && sourceY >= 0 && sourceY < height)) continue;
+            size_t source = static_cast<size_t> (sourceX) + width * static_cast<size_t> (sourceY);
+            if(referenceDepth[source] < CLEAR_DEPTH) continue;
+            holeStates[i] = HOLE_UNCHECKED;
+            holeSources[i] = static_cast<uint32_t> (source);
+        }
+    }
+
+    // Rays are only followed in from the ends of each run of holes, across
+    // and down, until one was seen. A hidden stretch of holes reaches the
+    // surface that hid it, or the screen edge if that is now out of view.
+    auto unfillable = [&](size_t x, size_t y) {
+        uint8_t &state = holeStates[x + width * y];
+        if(state == HOLE_UNCHECKED) state = _rayWasSeen(T, x + 0.5f, y + 0.5f) ? HOLE_SEEN : HOLE_UNFILLABLE;
+        return state == HOLE_UNFILLABLE;
+    };
+    auto isHole = [&](size_t x, size_t y) {return depths[x + width * y] == HOLE_DEPTH;};
+    for(size_t y = 0; y < height; y++) {
+        for(size_t x = 0; x < width; x++) {
+            if(!isHole(x, y)) continue;
+            if(x == 0 || !isHole(x - 1, y)) { // First in its run across
+                for(size_t walk = x; walk < width && isHole(walk, y) && unfillable(walk, y); walk++) {}
+            }
+            if(x + 1 == width || !isHole(x + 1, y)) { // Last in its run across
+                for(size_t walk = x + 1; walk > 0 && isHole(walk - 1, y) && unfillable(walk - 1, y); walk--) {}
+            }
+            if(y == 0 || !isHole(x, y - 1)) { // First in its run down
+                for(size_t walk = y; walk < height && isHole(x, walk) && unfillable(x, walk); walk++) {}
+            }
+            if(y + 1 == height || !isHole(x, y + 1)) { // Last in its run down
+                for(size_t walk = y + 1; walk > 0 && isHole(x, walk - 1) && unfillable(x, walk - 1); walk--) {}
+            }
+        }
+    }
+
+    for(size_t i = 0; i < width * height; i++) {
+        if(depths[i] != HOLE_DEPTH || holeStates[i] == HOLE_UNFILLABLE) continue;
+        pixels[i] = referenceColor[holeSources[i]];
+        depths[i] = CLEAR_DEPTH;
+    }
+}
+
+bool Reprojector::_rayWasSeen(const std::array<float, 16> &T, float pixelX, float pixelY) const {
+    // The ray projects to a line in the reference, from its direction at the
+    // far plane in towards where it leaves the near plane, and depth is
+    // linear along it. Stepping a pixel at a time from the far end, the ray
+    // was hidden wherever a reference surface is nearer than it. Points
+    // nearer than every reference surface were seen, so stepping stops there.
+    point4D farPoint = matrixVectorMultiply(T, point4D(pixelX, pixelY, 1, 1));
+    point4D nearPoint = matrixVectorMultiply(T, point4D(pixelX, pixelY, -1, 1));
+    if(farPoint.w < MIN_RAY_W) return false;
+    if(nearPoint.w < MIN_RAY_W) { // Cut off where the ray passes behind the reference camera
+        float t = (farPoint.w - MIN_RAY_W) / (farPoint.w - nearPoint.w);
+        nearPoint = point4D(farPoint.x + t * (nearPoint.x - farPoint.x), farPoint.y + t * (nearPoint.y - farPoint.y),
+                            farPoint.z + t * (nearPoint.z - farPoint.z), MIN_RAY_W);
+    }
+    float startX = farPoint.x / farPoint.w, startY = farPoint.y / farPoint.w, startDepth = farPoint.z / farPoint.w;
+    float stepX = nearPoint.x / nearPoint.w - startX, stepY = nearPoint.y / nearPoint.w - startY;
+    float stepDepth = nearPoint.z / nearPoint.w - startDepth;
+    if(!(startX >= 0 && startX < width && startY >= 0 && startY < height)) return false; // Outside the reference view
+
+    // Only the part of the line on screen
+    float end = 1;
+    if(stepX < 0) end = std::min(end, -startX / stepX);
+    if(stepX > 0) end = std::min(end, (width - startX) / stepX);
+    if(stepY < 0) end = std::min(end, -startY / stepY);
+    if(stepY > 0) end = std::min(end, (height - startY) / stepY);
+    float steps = static_cast<float> (-floorToInt(-std::max(std::fabs(stepX), std::fabs(stepY)) * end));
+    if(!(steps >= 1)) return true;
+    stepX /= steps;
+    stepY /= steps;
+    stepDepth /= steps;
+
+    for(float i = 0; i <= steps; i++) {
+        float depth = startDepth + i * stepDepth;
+        if(depth < nearestReferenceDepth) break;
+        size_t x = std::min(static_cast<size_t> (std::max(startX + i * stepX, 0.0f)), width - 1);
+        size_t y = std::min(static_cast<size_t> (std::max(startY + i * stepY, 0.0f)), height - 1);
+        float surface = referenceDepth[x + width * y];
+        if(surface < depth && surface < CLEAR_DEPTH) return false;
+    }
+    return true;
+}
+
+void Reprojector::_fillCracks(colorARGB* pixels, float* depths) {
+    // Surfaces that grow on screen leave single pixel gaps between warped
+    // pixels. Fill each from the farther of the pixels either side of it,
+    // across or down, as a gap at an edge is most likely the surface behind
+    // coming into view. At the screen edges the one pixel inside is used.
+    // Gaps crossing diagonally only close up once their neighbours are
+    // filled, so the passes run twice.
+    auto fill = [&](size_t i, size_t before, size_t after) {
+        if(depths[before] == HOLE_DEPTH || depths[after] == HOLE_DEPTH) return false;
+        size_t from = depths[before] >= depths[after] ? before : after;
+        pixels[i] = pixels[from];
+        depths[i] = depths[from];
+        return true;
+    };
+    if(width < 2 || height < 2) return;
+
+    for(int pass = 0; pass < 2; pass++) {
+        for(size_t tileY = 0; tileY < tilesY; tileY++) { // Only tiles with holes are visited
+            for(size_t tileX = 0; tileX < tilesX; tileX++) {
+                if(!dirty[tileX + tilesX * tileY]) continue;
+                size_t x0 = tileX * REDRAW_TILE_SIZE, x1 = std::min(x0 + REDRAW_TILE_SIZE, width);
+                size_t y0 = tileY * REDRAW_TILE_SIZE, y1 = std::min(y0 + REDRAW_TILE_SIZE, height);
+                for(size_t y = y0; y < y1; y++) {
+                    size_t up = y > 0 ? y - 1 : y + 1, below = y + 1 < height ? y + 1 : y - 1;
+                    for(size_t x = x0; x < x1; x++) {
+                        size_t i = x + width * y;
+                        if(depths[i] != HOLE_DEPTH) continue;
+                        size_t left = x > 0 ? x - 1 : x + 1, right = x + 1 < width ? x + 1 : x - 1;
+                        if(!fill(i, left + width * y, right + width * y)) fill(i, x + width * up, x + width * below);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void renderReprojected(Camera &camera, Reprojector &reprojector, std::vector<worldTriangle> &triangles,
+                       size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr,
+                       AlignedBuffer<float> &depthBuffer, FrameArena &arena) {
+
+    std::array<float, 16> combinedM = viewProjectionMatrix(camera, width, height);
+    reprojector.reproject(combinedM, width, height, imageArr, depthBuffer);
+    const uint8_t* dirtyTiles = reprojector.prepareRedraw(imageArr, depthBuffer);
+    drawBatch batch(arena);
+    drawTriangles(camera, triangles.data(), triangles.size(), combinedM, width, height, imageArr, depthBuffer,
+                  batch, dirtyTiles);
+    reprojector.finishFrame(imageArr, depthBuffer);
+}
+
+void renderReprojected(Camera &camera, Reprojector &reprojector, const compactMesh &mesh,
+                       size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr,
+                       AlignedBuffer<float> &depthBuffer, FrameArena &arena) {
+
+    std::array<float, 16> combinedM = viewProjectionMatrix(camera, width, height);
+    reprojector.reproject(combinedM, width, height, imageArr, depthBuffer);
+    const uint8_t* dirtyTiles = reprojector.prepareRedraw(imageArr, depthBuffer);
+    drawBatch batch(arena);
+    drawCompactTriangles(camera, mesh, combinedM, width, height, imageArr, depthBuffer, batch, dirtyTiles);
+    reprojector.finishFrame(imageArr, depthBuffer);
+}
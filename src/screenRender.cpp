@@ -1,83 +1,91 @@
-#include <windows.h>
-#include <gdiplus.h>
 #include <array>
 #include <vector>
 #include <algorithm>
+#include "frameArena.hpp"
+#include "kernels.hpp"
 #include "matrices.hpp"
 #include "screenRender.hpp"
 
-// Convert clip space coordinates to screen space coordinates
-void clipToScreenSpace(point4D &clipVertex, size_t screenWidth, size_t screenHeight) {
-    clipVertex.x = screenWidth - (clipVertex.x + 1.0f) * screenWidth * 0.5f;
-    clipVertex.y = screenHeight - (clipVertex.y + 1.0f) * screenHeight * 0.5f;
-    clipVertex.z = clipVertex.z;
-    clipVertex.w = clipVertex.w;
+namespace {
+
+// True if the screen space bounds overlap a tile marked in dirtyTiles, checked
+// before setting up a triangle so ones that cannot be drawn are skipped early
+bool boundsTouchDirtyTile(const uint8_t* dirtyTiles, size_t tilesX, size_t width, size_t height,
+                          float left, float top, float right, float bottom) {
+    if(!(right >= 0 && bottom >= 0 && left < width && top < height)) return false; // Also rejects NaN
+    size_t firstX = static_cast<size_t> (std::max(left, 0.0f)) / REDRAW_TILE_SIZE;
+    size_t lastX = static_cast<size_t> (std::min(right, width - 1.0f)) / REDRAW_TILE_SIZE;
+    size_t firstY = static_cast<size_t> (std::max(top, 0.0f)) / REDRAW_TILE_SIZE;
+    size_t lastY = static_cast<size_t> (std::min(bottom, height - 1.0f)) / REDRAW_TILE_SIZE;
+    for(size_t tileY = firstY; tileY <= lastY; tileY++) {
+        for(size_t tileX = firstX; tileX <= lastX; tileX++) {
+            if(dirtyTiles[tileX + tilesX * tileY]) return true;
+        }
+    }
+    return false;
 }
 
-// Transforms a vertex in world space to clip space
-// Returns true if vertex is clipped, else returns false
-bool transformVertexToClip(point4D &vertex, std::array<float, 16> matrix, Camera &camera, float aspectRatio) {
-    vertex = matrixVectorMultiply(matrix, vertex);
+// Rasterize transformed triangles, three vertices each in order. Only
+// triangles entirely outside the view volume are skipped, culling is done
+// when gathering.
+void rasterizeTriangles(const float* screenX, const float* screenY, const float* screenZ, const uint8_t* outcode,
+                        const colorARGB* colors, size_t triangleCount, size_t width, size_t height,
+                        AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, const uint8_t* dirtyTiles) {
+
+    const renderKernels &kernels = getKernels();
+    colorARGB* pixels = imageArr.data();
+    float* depths = depthBuffer.data();
+
+    size_t tilesX = (width + REDRAW_TILE_SIZE - 1) / REDRAW_TILE_SIZE;
+    for(size_t i = 0; i < triangleCount; i++) {
+        size_t a = 3 * i, b = 3 * i + 1, c = 3 * i + 2;
+        if((outcode[a] & outcode[b] & outcode[c]) != 0) continue; // Every vertex outside the same plane of the view volume
+        if(dirtyTiles != nullptr && !boundsTouchDirtyTile(dirtyTiles, tilesX, width, height,
+                                                          std::min({screenX[a], screenX[b], screenX[c]}),
+                                                          std::min({screenY[a], screenY[b], screenY[c]}),
+                                                          std::max({screenX[a], screenX[b], screenX[c]}),
+                                                          std::max({screenY[a], screenY[b], screenY[c]}))) continue;
+
+        screenTriangle screenTri(point4D(screenX[a], screenY[a], screenZ[a], 1),
+                                 point4D(screenX[b], screenY[b], screenZ[b], 1),
+                                 point4D(screenX[c], screenY[c], screenZ[c], 1));
+        colorARGB triangleColor = colors[i];
 
-    if(vertex.x > vertex.w || vertex.x < -vertex.w ||
-       vertex.y > vertex.w || vertex.y < -vertex.w ||
-       vertex.z > camera.getFar() || vertex.z < -camera.getNear()) {
-
-        return TRUE;
-    }
+        int triTop = screenTri.getTop();
+        int triBottom = screenTri.getBottom();
+        int triLeft = screenTri.getLeft();
+        int triRight = screenTri.getRight();
 
-    return FALSE;
-}
+        triTop = std::clamp(triTop, 0, static_cast<int> (height-1));
+        triBottom = std::clamp(triBottom, 0, static_cast<int> (height-1));
+        triLeft = std::clamp(triLeft, 0, static_cast<int> (width-1));
+        triRight = std::clamp(triRight, 0, static_cast<int> (width-1));
 
-void OnPaint(HDC hdc, size_t width, size_t height, std::vector<Gdiplus::ARGB> &imageArr, Camera &camera) {
-    Gdiplus::Graphics graphics(hdc);
-    Gdiplus::Bitmap bitmap(width, height, PixelFormat32bppARGB);
-    Gdiplus::BitmapData bitmapData;
-    Gdiplus::Rect rect(0,0,width,height);
-    Gdiplus::Status status = bitmap.LockBits(
-        &rect,
-        Gdiplus::ImageLockModeWrite,
-        PixelFormat32bppARGB,
-        &bitmapData
-    );
-
-    if (status == Gdiplus::Ok) {
-        // Get the pointer to the first pixel in the locked memory
-        BYTE* pixels = (BYTE*)bitmapData.Scan0;
-        INT stride = bitmapData.Stride;
-        Gdiplus::ARGB color;
-
-        for (size_t y = 0; y < height; y++) {
-            for (size_t x = 0; x < width; x++) {
-                // Calculate the index in the raw byte array
-                // Stride is the width of a single row in bytes, which might be more than (width * bytes_per_pixel) due to alignment
-                long index = (y * stride) + (x * 4); // 4 bytes per pixel for 32bppARGB
-
-                color = imageArr[x + width * y];
-
-                pixels[index + 0] = (BYTE)((color >> 0) & 0xff);  // Blue
-                pixels[index + 1] = (BYTE)((color >> 8) & 0xff);  // Green
-                pixels[index + 2] = (BYTE)((color >> 16) & 0xff); // Red
-                pixels[index + 3] = (BYTE)((color >> 24) & 0xff); // Alpha
+        spanSetup setup = screenTri.getSpanSetup();
+        if(dirtyTiles == nullptr) {
+            for(int y = triTop; y <= triBottom; y++) { // Check pixels within bounding box if in triangle
+                kernels.rasterSpan(setup, y, triLeft, triRight, triangleColor, pixels + width * y, depths + width * y);
             }
+            continue;
         }
 
-        // Unlock the bitmap data
-        bitmap.UnlockBits(&bitmapData);
-    }
-    graphics.DrawImage(&bitmap, 0, 0);
-}
-
-void renderImage(Camera &camera, std::vector<worldTriangle> &triangles, size_t width, size_t height,
-                 std::vector<Gdiplus::ARGB> &imageArr, std::vector<float> &depthBuffer) {
-
-    for(size_t y = 0; y < height; y++) {
-        for(size_t x = 0; x < width; x++) {
-            imageArr[x + y * width] = 0xFF000000; // Clear imageArr and depthBuffer
-            depthBuffer[x + y * width] = 1;
+        for(int y = triTop; y <= triBottom; y++) { // Same, but only over runs of dirty tiles
+            const uint8_t* tileRow = dirtyTiles + (y / REDRAW_TILE_SIZE) * tilesX;
+            int lastTile = triRight / REDRAW_TILE_SIZE;
+            for(int tile = triLeft / REDRAW_TILE_SIZE; tile <= lastTile; tile++) {
+                if(!tileRow[tile]) continue;
+                int runStart = tile;
+                while(tile < lastTile && tileRow[tile + 1]) tile++;
+                int spanLeft = std::max(triLeft, runStart * REDRAW_TILE_SIZE);
+                int spanRight = std::min(triRight, (tile + 1) * REDRAW_TILE_SIZE - 1);
+                kernels.rasterSpan(setup, y, spanLeft, spanRight, triangleColor, pixels + width * y, depths + width * y);
+            }
         }
     }
+}
+}
 
+std::array<float, 16> viewProjectionMatrix(Camera &camera, size_t width, size_t height) {
     float aspectRatio = static_cast<float> (width) / static_cast<float> (height);
 
     std::array<float, 16> cameraToOriginM;
@@ -96,146 +104,65 @@ void renderImage(Camera &camera, std::vector<worldTriangle> &triangles, size_t w
     combinedM = matrixMultiply(cameraRotateYawM, cameraToOriginM);
     combinedM = matrixMultiply(cameraRotatePitchM, combinedM);
     combinedM = matrixMultiply(cameraToClipM, combinedM);
+    return combinedM;
+}
 
-    for(auto& worldTri : triangles) {
-        screenTriangle screenTri(worldTri, camera, width, height, combinedM);
-        if(screenTri.isCulled()) continue;
-
-        Gdiplus::ARGB triangleColor = 0xFFFF0000;
-        point4D normal = worldTri.getNormal();
-        triangleColor = Gdiplus::Color::MakeARGB( // Set face colour depending on normal vector direction
-            0xFF,
-            static_cast<BYTE> (0xFF * (normal.x+1)/2),
-            static_cast<BYTE> (0xFF * (normal.y+1)/2),
-            static_cast<BYTE> (0xFF * (normal.z+1)/2)
-        );
+void clearImage(size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer) {
+    getKernels().clearFrame(imageArr.data(), depthBuffer.data(), width * height, 0xFF000000, 1.0f);
+}
 
-        int triTop = screenTri.getTop();
-        int triBottom = screenTri.getBottom();
-        int triLeft = screenTri.getLeft();
-        int triRight = screenTri.getRight();
+drawBatch::drawBatch(FrameArena &arena) : count(0) {
+    size_t vertexCount = DRAW_BATCH_SIZE * 3;
+    worldX = arena.allocateArray<float>(vertexCount);
+    worldY = arena.allocateArray<float>(vertexCount);
+    worldZ = arena.allocateArray<float>(vertexCount);
+    colors = arena.allocateArray<colorARGB>(DRAW_BATCH_SIZE);
+    screenX = arena.allocateArray<float>(vertexCount);
+    screenY = arena.allocateArray<float>(vertexCount);
+    screenZ = arena.allocateArray<float>(vertexCount);
+    outcode = arena.allocateArray<uint8_t>(vertexCount);
+}
 
-        triTop = std::clamp(triTop, 0, static_cast<int> (height-1));
-        triBottom = std::clamp(triBottom, 0, static_cast<int> (height-1));
-        triLeft = std::clamp(triLeft, 0, static_cast<int> (width-1));
-        triRight = std::clamp(triRight, 0, static_cast<int> (width-1));
+void flushBatch(drawBatch &batch, Camera &camera, const std::array<float, 16> &combinedM, size_t width, size_t height,
+                AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, const uint8_t* dirtyTiles) {
+    transformVerticesToScreen(combinedM, batch.worldX, batch.worldY, batch.worldZ, batch.count * 3,
+                              camera.getNear(), camera.getFar(), static_cast<float> (width), static_cast<float> (height),
+                              batch.screenX, batch.screenY, batch.screenZ, batch.outcode);
+    rasterizeTriangles(batch.screenX, batch.screenY, batch.screenZ, batch.outcode, batch.colors, batch.count,
+                       width, height, imageArr, depthBuffer, dirtyTiles);
+    batch.count = 0;
+}
 
-        for(int y = triTop; y <= triBottom; y++) { // Check pixels within bounding box if in triangle
-            for(int x = triLeft; x <= triRight; x++) {
-                float depth;
-                bool pointInTriangle = screenTri.checkPointInTriangle(x + 0.5f, y + 0.5f, depth);
-                if(pointInTriangle == TRUE && depth < depthBuffer[x + width * y]) {
-                    imageArr[x + width * y] = triangleColor;
-                    depthBuffer[x + width * y] = depth;
-                }
-            }
+void drawTriangles(Camera &camera, const worldTriangle* triangles, size_t triangleCount, const std::array<float, 16> &combinedM,
+                   size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer,
+                   drawBatch &batch, const uint8_t* dirtyTiles) {
+
+    // Gather the vertex positions of front facing triangles into separate x,
+    // y, z arrays for the batched transform, culled ones are never transformed
+    point4D cameraPos = camera.getPos();
+    for(size_t i = 0; i < triangleCount; i++) {
+        point4D normal = triangles[i].getNormal();
+        point4D vertices[3] = {triangles[i].getAPos(), triangles[i].getBPos(), triangles[i].getCPos()};
+        point4D cameraVec(cameraPos, vertices[0]);
+        if((normal.x * cameraVec.x + normal.y * cameraVec.y + normal.z * cameraVec.z) > 0.0f) continue; //Dot product for backface culling
+
+        size_t first = 3 * batch.count;
+        for(size_t j = 0; j < 3; j++) {
+            batch.worldX[first + j] = vertices[j].x;
+            batch.worldY[first + j] = vertices[j].y;
+            batch.worldZ[first + j] = vertices[j].z;
         }
+        batch.colors[batch.count] = faceColor(normal);
+        if(++batch.count == DRAW_BATCH_SIZE) flushBatch(batch, camera, combinedM, width, height, imageArr, depthBuffer, dirtyTiles);
     }
+    flushBatch(batch, camera, combinedM, width, height, imageArr, depthBuffer, dirtyTiles);
 }
 
-screenTriangle::screenTriangle(worldTriangle &worldTri, Camera &camera,
-                               float width, float height, std::array<float, 16> &matrix) {
-
-    point4D normal = worldTri.getNormal();
-    point4D cameraVec(camera.getPos(), worldTri.getAPos());
-
-    if((normal.x * cameraVec.x + normal.y * cameraVec.y + normal.z * cameraVec.z) > 0.0f) { //Dot product for backface culling
-        culled = TRUE;
-        return;
-    }
-
-    float aspectRatio = static_cast<float> (width) / static_cast<float> (height);
-    A = worldTri.getAPos();
-    B = worldTri.getBPos();
-    C = worldTri.getCPos();
-
-    bool aClipped = transformVertexToClip(A, matrix, camera, aspectRatio);
-    bool bClipped = transformVertexToClip(B, matrix, camera, aspectRatio);
-    bool cClipped = transformVertexToClip(C, matrix, camera, aspectRatio);
-
-    if(aClipped  && bClipped && cClipped) {
-        culled = TRUE;
-        return;
-    }
-    culled = FALSE;
-
-    A.perspectiveDivide();
-    B.perspectiveDivide();
-    C.perspectiveDivide();
-
-    clipToScreenSpace(A, width, height);
-    clipToScreenSpace(B, width, height);
-    clipToScreenSpace(C, width, height);
-
-    triTop = static_cast<int> (floor(std::min({A.y, B.y, C.y})));
-    triBottom = static_cast<int> (ceil(std::max({A.y, B.y, C.y})));
-    triLeft = static_cast<int> (floor(std::min({A.x, B.x, C.x})));
-    triRight = static_cast<int> (ceil(std::max({A.x, B.x, C.x})));
-
-    v0x = B.x - A.x;
-    v0y = B.y - A.y;
-    v1x = C.x - A.x;
-    v1y = C.y - A.y;
+void renderImage(Camera &camera, std::vector<worldTriangle> &triangles, size_t width, size_t height,
+                 AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena) {
 
-    detInverse = 1 / (v0x * v1y - v0y * v1x);
+    clearImage(width, height, imageArr, depthBuffer);
+    std::array<float, 16> combinedM = viewProjectionMatrix(camera, width, height);
+    drawBatch batch(arena);
+    drawTriangles(camera, triangles.data(), triangles.size(), combinedM, width, height, imageArr, depthBuffer, batch);
 }
-
-bool Camera::updateCameraPos(HWND hWnd, UINT Message, USHORT VKey) {
-    if(Message != WM_KEYDOWN) return FALSE;
-    switch(VKey) {
-        case VK_SPACE: // Increase y height when space pressed
-            yPos += 0.1f;
-            return TRUE;
-        case VK_SHIFT: // Decrease y height when shift pressed
-            yPos += -0.1f;
-            return TRUE;
-        case 0x57: //W
-            zPos += 0.1f * cos(yaw); //add units in camera yaw direction in zx plane
-            xPos += 0.1f * sin(yaw);
-            return TRUE;
-        case 0x53: //S
-            zPos += 0.1f * -cos(yaw); //subtract units in camera yaw direction in zx plane
-            xPos += 0.1f * -sin(yaw);
-            return TRUE;
-        case 0x41: //A
-            zPos += 0.1f * -sin(yaw); // add units perpendicular to yaw in zx plane
-            xPos += 0.1f * cos(yaw);
-            return TRUE;
-        case 0x44: //D
-            zPos += 0.1f * sin(yaw); // subtract units perpendicular to yaw in zx plane
-            xPos += 0.1f * -cos(yaw);
-            return TRUE;
-        case VK_ESCAPE: // Toggle enable/disable cursor
-            {
-            CURSORINFO cursorInfo;
-            cursorInfo.cbSize = sizeof(cursorInfo);
-            RECT rect;
-            if(GetCursorInfo(&cursorInfo) && GetClientRect(hWnd, &rect)) {
-                POINT pointTL, pointBR;
-                pointTL.x = rect.left;
-                pointTL.y = rect.top;
-                pointBR.x = rect.right;
-                pointBR.y = rect.bottom;
-                    
-                ClientToScreen(hWnd, &pointTL);
-                ClientToScreen(hWnd, &pointBR);
-
-                rect.left = pointTL.x;
-                rect.top = pointTL.y;
-                rect.right = pointBR.x;
-                rect.bottom = pointBR.y;
-
-                if(cursorInfo.flags == CURSOR_SHOWING) {
-                    ShowCursor(FALSE);
-                    ClipCursor(&rect);
-                } else {
-                    ShowCursor(TRUE);
-                    SetCursorPos((rect.right + rect.left) / 2, (rect.bottom - rect.top) / 2);
-                    ClipCursor(NULL);
-                }
-            }
-            }
-            return TRUE;
-    }
-    return FALSE;
-}
\ No newline at end of file
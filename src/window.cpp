@@ -0,0 +1,91 @@
+#include <windows.h>
+#include <gdiplus.h>
+#include <cmath>
+#include "kernels.hpp"
+#include "screenRender.hpp"
+
+// Windows only parts of screenRender.hpp, the rest builds on any platform
+
+void OnPaint(HDC hdc, size_t width, size_t height, AlignedBuffer<colorARGB> &imageArr, Camera &camera) {
+    Gdiplus::Graphics graphics(hdc);
+    Gdiplus::Bitmap bitmap(width, height, PixelFormat32bppARGB);
+    Gdiplus::BitmapData bitmapData;
+    Gdiplus::Rect rect(0,0,width,height);
+    Gdiplus::Status status = bitmap.LockBits(
+        &rect,
+        Gdiplus::ImageLockModeWrite,
+        PixelFormat32bppARGB,
+        &bitmapData
+    );
+
+    if (status == Gdiplus::Ok) {
+        // Stride is the width of a single row in bytes, which might be more than (width * bytes_per_pixel) due to alignment.
+        // 32bppARGB stores each pixel as the little endian bytes of its ARGB value, so rows copy directly
+        getKernels().copyFrame(static_cast<uint8_t*> (bitmapData.Scan0), bitmapData.Stride,
+                               imageArr.data(), width, height);
+
+        // Unlock the bitmap data
+        bitmap.UnlockBits(&bitmapData);
+    }
+    graphics.DrawImage(&bitmap, 0, 0);
+}
+
+bool Camera::updateCameraPos(HWND hWnd, UINT Message, USHORT VKey) {
+    if(Message != WM_KEYDOWN) return FALSE;
+    switch(VKey) {
+        case VK_SPACE: // Increase y height when space pressed
+            yPos += 0.1f;
+            return TRUE;
+        case VK_SHIFT: // Decrease y height when shift pressed
+            yPos += -0.1f;
+            return TRUE;
+        case 0x57: //W
+            zPos += 0.1f * cos(yaw); //add units in camera yaw direction in zx plane
+            xPos += 0.1f * sin(yaw);
+            return TRUE;
+        case 0x53: //S
+            zPos += 0.1f * -cos(yaw); //subtract units in camera yaw direction in zx plane
+            xPos += 0.1f * -sin(yaw);
+            return TRUE;
+        case 0x41: //A
+            zPos += 0.1f * -sin(yaw); // add units perpendicular to yaw in zx plane
+            xPos += 0.1f * cos(yaw);
+            return TRUE;
+        case 0x44: //D
+            zPos += 0.1f * sin(yaw); // subtract units perpendicular to yaw in zx plane
+            xPos += 0.1f * -cos(yaw);
+            return TRUE;
+        case VK_ESCAPE: // Toggle enable/disable cursor
+            {
+            CURSORINFO cursorInfo;
+            cursorInfo.cbSize = sizeof(cursorInfo);
+            RECT rect;
+            if(GetCursorInfo(&cursorInfo) && GetClientRect(hWnd, &rect)) {
+                POINT pointTL, pointBR;
+                pointTL.x = rect.left;
+                pointTL.y = rect.top;
+                pointBR.x = rect.right;
+                pointBR.y = rect.bottom;
+                    
+                ClientToScreen(hWnd, &pointTL);
+                ClientToScreen(hWnd, &pointBR);
+
+                rect.left = pointTL.x;
+                rect.top = pointTL.y;
+                rect.right = pointBR.x;
+                rect.bottom = pointBR.y;
+
+                if(cursorInfo.flags == CURSOR_SHOWING) {
+                    ShowCursor(FALSE);
+                    ClipCursor(&rect);
+                } else {
+                    ShowCursor(TRUE);
+                    SetCursorPos((rect.right + rect.left) / 2, (rect.bottom - rect.top) / 2);
+                    ClipCursor(NULL);
+                }
+            }
+            }
+            return TRUE;
+    }
+    return FALSE;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "frameArena.hpp"
+#include "readObj.hpp"
+#include "screenRender.hpp"
+
+// Checks that rendering stops touching the heap once the frame arena has
+// grown, and that the growth itself is counted.
+//
+// allocationTest [--media-dir DIR]
+//
+// Renders the sample model for a few frames from an arena far too small for
+// a frame. The first frames overflow the arena and grow it, later frames
+// must make no heap allocations at all.
+
+namespace {
+
+constexpr size_t IMAGE_WIDTH = 320;
+constexpr size_t IMAGE_HEIGHT = 240;
+constexpr int FRAMES = 6;
+constexpr size_t INITIAL_ARENA_BYTES = 1024;
+
+}
+
+int main(int argc, char** argv) {
+    std::string mediaDir = "media";
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--media-dir") == 0 && i + 1 < argc) {
+            mediaDir = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: allocationTest [--media-dir DIR]\n");
+            return 2;
+        }
+    }
+
+    std::vector<worldTriangle> triangles;
+    objToTriangles(mediaDir + "/model", triangles);
+    if(triangles.empty()) {
+        std::fprintf(stderr, "could not load %s/model.obj\n", mediaDir.c_str());
+        return 2;
+    }
+
+    AlignedBuffer<colorARGB> imageArr(IMAGE_WIDTH * IMAGE_HEIGHT);
+    AlignedBuffer<float> depthBuffer(IMAGE_WIDTH * IMAGE_HEIGHT);
+    FrameArena arena(INITIAL_ARENA_BYTES);
+    Camera camera(0, 0, 5, 0, 180, 0, 80, 0.5, 100);
+
+    bool passed = true;
+    for(int frame = 0; frame < FRAMES; frame++) {
+        allocStats::beginFrame();
+        arena.reset();
+        renderImage(camera, triangles, IMAGE_WIDTH, IMAGE_HEIGHT, imageArr, depthBuffer, arena);
+        size_t allocations = allocStats::frameAllocations();
+
+        // The arena overflows on the first frame and grows on the second,
+        // after that it holds a whole frame
+        bool expectZero = frame >= 2;
+        bool ok = expectZero ? allocations == 0 : allocations > 0;
+        std::printf("frame %d: %zu heap allocations, arena %zu bytes%s\n", frame, allocations, arena.getCapacity(),
+                    ok ? "" : ", FAILED");
+        passed &= ok;
+    }
+    return passed ? 0 : 1;
+}
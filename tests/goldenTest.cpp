@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "compactMesh.hpp"
+#include "frameArena.hpp"
+#include "kernels.hpp"
+#include "readObj.hpp"
+#include "reprojection.hpp"
+#include "screenRender.hpp"
+
+// Golden image regression test. Renders a scene from fixed camera poses at a
+// fixed resolution with every kernel set the CPU supports, and compares each
+// image against a stored reference. Rendering is single threaded, so output
+// only depends on the scene and the kernels.
+//
+// goldenTest --scene NAME --golden-dir DIR [--media-dir DIR] [--output-dir DIR]
+//            [--update] [--walk] [--channel-tolerance N] [--max-bad-pixels P] [--min-psnr DB]
+//
+// A pixel is bad if any channel differs by more than the channel tolerance.
+// An image passes if at most P percent of its pixels are bad and its PSNR is
+// at least DB. Failing images are written to the output directory along with
+// a diff image marking bad pixels in red. --update rewrites the references
+// from the scalar kernels.
+//
+// --reproject renders each pose by reprojection instead, after a few frames
+// moving in towards it from a slightly different pose. The reprojector never
+// falls back to a full redraw however many tiles need redrawing, and the
+// test fails if a pose is redrawn in full anyway.
+//
+// --compact renders from the scene encoded as a compactMesh, and reports its
+// error bound. Fails if a vertex is further from its original position than
+// the bound allows.
+//
+// --walk needs no references. It walks forward from the first pose in
+// WALK_STEP unit steps for a whole refresh interval of a default reprojector,
+// and compares every frame against the same frame drawn in full.
+
+namespace {
+
+constexpr size_t IMAGE_WIDTH = 320;
+constexpr size_t IMAGE_HEIGHT = 240;
+
+struct options {
+    std::string scene;
+    std::string goldenDir;
+    std::string mediaDir = "media";
+    std::string outputDir = "goldenOutput";
+    bool update = false;
+    bool reproject = false;
+    bool compact = false;
+    bool walk = false;
+    int channelTolerance = 2;
+    double maxBadPixelsPercent = 0.1;
+    double minPsnr = 40.0;
+};
+
+struct rgbImage {
+    size_t width = 0, height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+// Frames rendered on the way to each pose when testing reprojection, the
+// first one REPROJECT_MOVE units and REPROJECT_TURN degrees away
+constexpr int REPROJECT_FRAMES = 5;
+constexpr float REPROJECT_MOVE = 0.2f;
+constexpr float REPROJECT_TURN = 2.0f;
+
+constexpr float WALK_STEP = 0.1f;
+
+// Camera poses every scene is rendered from
+std::vector<Camera> goldenPoses() {
+    return {
+        Camera(0, 0, 5, 0, 180, 0, 80, 0.5, 100), // Straight on
+        Camera(2, 1.5, 4, -15, 205, 0, 80, 0.5, 100), // Above and to the side, looking down
+        Camera(0, 0, 2.5, 0, 180, 0, 60, 0.5, 100) // Close up with a narrow fov
+    };
+}
+
+void addTriangle(std::vector<worldTriangle> &triangles, float ax, float ay, float az,
+                 float bx, float by, float bz, float cx, float cy, float cz) {
+    triangles.emplace_back(point4D(ax, ay, az, 1), point4D(bx, by, bz, 1), point4D(cx, cy, cz, 1));
+}
+
+// Disc of triangles sharing a centre vertex, plus a grid of quads split into
+// two triangles each. Every edge is shared, so any gap shows as black.
+void buildFan(std::vector<worldTriangle> &triangles) {
+    constexpr int SEGMENTS = 32;
+    for(int i = 0; i < SEGMENTS; i++) {
+        float a0 = 2 * static_cast<float> (M_PI) * i / SEGMENTS;
+        float a1 = 2 * static_cast<float> (M_PI) * (i + 1) / SEGMENTS;
+        addTriangle(triangles, -1, 0.5f, 0, -1 + cosf(a0), 0.5f + sinf(a0), 0, -1 + cosf(a1), 0.5f + sinf(a1), 0);
+    }
+
+    constexpr int GRID = 8;
+    for(int y = 0; y < GRID; y++) {
+        for(int x = 0; x < GRID; x++) {
+            float x0 = 0.25f + x * 0.25f, y0 = -1.5f + y * 0.25f;
+            float x1 = x0 + 0.25f, y1 = y0 + 0.25f;
+            float z = 0.05f * ((x + y) % 2); // Alternate quads are offset in depth, so tilted neighbours meet at an angle
+            addTriangle(triangles, x0, y0, 0, x1, y0, z, x1, y1, 0);
+            addTriangle(triangles, x0, y0, 0, x1, y1, 0, x0, y1, z);
+        }
+    }
+}
+
+// Two quads passing through each other at an angle, and a stack of
+// coplanar triangles with different windings, to exercise the depth test
+void buildOverlap(std::vector<worldTriangle> &triangles) {
+    addTriangle(triangles, -1.5f, -1, -0.5f, 1.5f, -1, 0.5f, 1.5f, 1, 0.5f);
+    addTriangle(triangles, -1.5f, -1, -0.5f, 1.5f, 1, 0.5f, -1.5f, 1, -0.5f);
+    addTriangle(triangles, -1.5f, -1, 0.5f, 1.5f, -1, -0.5f, 1.5f, 1, -0.5f);
+    addTriangle(triangles, -1.5f, -1, 0.5f, 1.5f, 1, -0.5f, -1.5f, 1, 0.5f);
+
+    for(int i = 0; i < 4; i++) { // Same plane, rotated copies, first drawn wins ties
+        float angle = i * 0.4f;
+        float c = cosf(angle), s = sinf(angle);
+        addTriangle(triangles, 0, -1.8f, 0.8f, 0.8f * c, -1.8f + 0.8f * s, 0.8f, -0.8f * s, -1.8f + 0.8f * c, 0.8f);
+    }
+}
+
+// Floor running from close to the camera into the distance, and triangles
+// crossing the near plane
+void buildNearPlane(std::vector<worldTriangle> &triangles) {
+    for(int i = 0; i < 16; i++) {
+        float z0 = 4.5f - i * 1.5f, z1 = z0 - 1.5f;
+        addTriangle(triangles, -2, -1, z0, 2, -1, z0, 2, -1, z1);
+        addTriangle(triangles, -2, -1, z0, 2, -1, z1, -2, -1, z1);
+    }
+    addTriangle(triangles, -0.5f, 0, 4.8f, 0.5f, 0, 3, 0, 0.8f, 3); // One vertex inside the near plane
+    addTriangle(triangles, -1, 0.2f, 3, 1, 0.2f, 3, 0, 1.2f, 4.7f);
+}
+
+// Needle thin and zero area triangles, and triangles smaller than a pixel
+void buildSlivers(std::vector<worldTriangle> &triangles) {
+    for(int i = 0; i < 12; i++) {
+        float x = -1.8f + i * 0.15f;
+        addTriangle(triangles, x, -1.5f, 0, x + 0.002f * (i + 1), -1.5f, 0, x + 0.05f, 1.5f, 0);
+    }
+    addTriangle(triangles, 0.5f, 0, 0, 1, 0.5f, 0, 1.5f, 1, 0); // Collinear
+    addTriangle(triangles, 0.5f, -0.5f, 0, 0.5f, -0.5f, 0, 0.5f, -0.5f, 0); // Single point
+
+    for(int y = 0; y < 20; y++) {
+        for(int x = 0; x < 20; x++) {
+            float px = 0.3f + x * 0.07f, py = -1.6f + y * 0.07f;
+            addTriangle(triangles, px, py, 0, px + 0.01f, py, 0, px, py + 0.01f, 0);
+        }
+    }
+}
+
+// Wall across the back, and a strip close to the camera at the right edge
+// of pose 0's view. The strip is outside the view reprojection approaches
+// pose 0 from, and covers wall that was in it, so it leaves no hole.
+void buildEntering(std::vector<worldTriangle> &triangles) {
+    addTriangle(triangles, -5, -4, -2, 5, -4, -2, 5, 4, -2);
+    addTriangle(triangles, -5, -4, -2, 5, 4, -2, -5, 4, -2);
+    addTriangle(triangles, 0.6f, -0.5f, 4, 0.7f, -0.5f, 3.9f, 0.7f, 0.5f, 3.9f); // Turned towards the centre, so its colour differs
+    addTriangle(triangles, 0.6f, -0.5f, 4, 0.7f, 0.5f, 3.9f, 0.6f, 0.5f, 4);
+}
+
+bool buildScene(const options &opts, std::vector<worldTriangle> &triangles) {
+    if(opts.scene == "model") objToTriangles(opts.mediaDir + "/model", triangles);
+    else if(opts.scene == "fan") buildFan(triangles);
+    else if(opts.scene == "overlap") buildOverlap(triangles);
+    else if(opts.scene == "nearPlane") buildNearPlane(triangles);
+    else if(opts.scene == "slivers") buildSlivers(triangles);
+    else if(opts.scene == "entering") buildEntering(triangles);
+    else return false;
+    return !triangles.empty();
+}
+
+rgbImage toRgb(const AlignedBuffer<colorARGB> &imageArr, size_t width, size_t height) {
+    rgbImage image;
+    image.width = width;
+    image.height = height;
+    image.rgb.resize(width * height * 3);
+    for(size_t i = 0; i < width * height; i++) {
+        image.rgb[3 * i + 0] = static_cast<uint8_t> (imageArr[i] >> 16);
+        image.rgb[3 * i + 1] = static_cast<uint8_t> (imageArr[i] >> 8);
+        image.rgb[3 * i + 2] = static_cast<uint8_t> (imageArr[i]);
+    }
+    return image;
+}
+
+// Binary PPM (P6), 8 bits per channel
+bool writePpm(const std::string &filename, const rgbImage &image) {
+    std::ofstream file(filename, std::ios::binary);
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    file.write(reinterpret_cast<const char*> (image.rgb.data()), image.rgb.size());
+    return static_cast<bool> (file);
+}
+
+bool readPpm(const std::string &filename, rgbImage &image) {
+    std::ifstream file(filename, std::ios::binary);
+    std::string magic;
+    int maxValue;
+    if(!(file >> magic >> image.width >> image.height >> maxValue) || magic != "P6" || maxValue != 255) return false;
+    file.get(); // Single whitespace before the pixel data
+    image.rgb.resize(image.width * image.height * 3);
+    return static_cast<bool> (file.read(reinterpret_cast<char*> (image.rgb.data()), image.rgb.size()));
+}
+
+// Compare against the reference, returns true if within tolerance. diff marks
+// bad pixels in red over a dimmed copy of the reference.
+bool compareImages(const rgbImage &reference, const rgbImage &actual, const options &opts,
+                   rgbImage &diff, size_t &badPixels, double &psnr) {
+    diff = reference;
+    badPixels = 0;
+    double squaredError = 0;
+    size_t pixels = reference.width * reference.height;
+    for(size_t i = 0; i < pixels; i++) {
+        int maxDelta = 0;
+        for(size_t c = 0; c < 3; c++) {
+            int delta = std::abs(reference.rgb[3 * i + c] - actual.rgb[3 * i + c]);
+            squaredError += delta * delta;
+            maxDelta = std::max(maxDelta, delta);
+        }
+        bool bad = maxDelta > opts.channelTolerance;
+        badPixels += bad;
+        for(size_t c = 0; c < 3; c++) {
+            diff.rgb[3 * i + c] = bad ? (c == 0 ? 255 : 0) : reference.rgb[3 * i + c] / 4;
+        }
+    }
+
+    double mse = squaredError / (pixels * 3);
+    psnr = mse == 0 ? INFINITY : 10 * std::log10(255.0 * 255.0 / mse);
+    return badPixels * 100.0 <= opts.maxBadPixelsPercent * pixels && psnr >= opts.minPsnr;
+}
+
+bool parseOptions(int argc, char** argv, options &opts) {
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--update") opts.update = true;
+        else if(arg == "--reproject") opts.reproject = true;
+        else if(arg == "--compact") opts.compact = true;
+        else if(arg == "--walk") opts.walk = true;
+        else if(arg == "--scene" && hasValue) opts.scene = argv[++i];
+        else if(arg == "--golden-dir" && hasValue) opts.goldenDir = argv[++i];
+        else if(arg == "--media-dir" && hasValue) opts.mediaDir = argv[++i];
+        else if(arg == "--output-dir" && hasValue) opts.outputDir = argv[++i];
+        else if(arg == "--channel-tolerance" && hasValue) opts.channelTolerance = std::atoi(argv[++i]);
+        else if(arg == "--max-bad-pixels" && hasValue) opts.maxBadPixelsPercent = std::atof(argv[++i]);
+        else if(arg == "--min-psnr" && hasValue) opts.minPsnr = std::atof(argv[++i]);
+        else return false;
+    }
+    if(opts.walk) return !opts.scene.empty() && !opts.update && !opts.reproject && !opts.compact;
+    return !opts.scene.empty() && !opts.goldenDir.empty() && !(opts.update && (opts.reproject || opts.compact));
+}
+
+// Render the pose with a reprojector that has followed the camera moving in
+// from a nearby pose, returns false if the final frame was redrawn in full.
+// Any number of dirty tiles is allowed, so the last frame is always built by
+// reprojection.
+template<typename Scene>
+bool renderReprojectedPose(const Camera &pose, Scene &scene, AlignedBuffer<colorARGB> &imageArr,
+                           AlignedBuffer<float> &depthBuffer, FrameArena &arena, size_t &dirtyTiles, size_t &tileCount) {
+    Camera target = pose;
+    point4D pos = target.getPos();
+    float pitch = target.getPitchR() * (180.0f / static_cast<float> (M_PI));
+    float yaw = target.getYawR() * (180.0f / static_cast<float> (M_PI));
+
+    Reprojector reprojector(REPROJECT_FRAMES + 1, 1.0f);
+    for(int frame = REPROJECT_FRAMES; frame >= 0; frame--) {
+        float move = REPROJECT_MOVE * frame / REPROJECT_FRAMES;
+        float turn = REPROJECT_TURN * frame / REPROJECT_FRAMES;
+        Camera camera(pos.x - move, pos.y + move * 0.5f, pos.z, pitch + turn * 0.5f, yaw - turn,
+                      0, target.getFovD(), target.getNear(), target.getFar());
+        arena.reset();
+        renderReprojected(camera, reprojector, scene, IMAGE_WIDTH, IMAGE_HEIGHT, imageArr, depthBuffer, arena);
+    }
+    dirtyTiles = reprojector.getDirtyTiles();
+    tileCount = reprojector.getTileCount();
+    return !reprojector.wasFullRedraw();
+}
+
+// Walk forward from pose, comparing each reprojected frame against the same
+// frame drawn in full. Returns false if any frame is out of tolerance.
+bool walkForward(const Camera &pose, std::vector<worldTriangle> &triangles, const options &opts, const char* isaName,
+                 AlignedBuffer<colorARGB> &imageArr, AlignedBuffer<float> &depthBuffer, FrameArena &arena) {
+    AlignedBuffer<colorARGB> expectedArr(IMAGE_WIDTH * IMAGE_HEIGHT);
+    Camera start = pose;
+    point4D pos = start.getPos();
+    float pitch = start.getPitchR() * (180.0f / static_cast<float> (M_PI));
+    float yaw = start.getYawR() * (180.0f / static_cast<float> (M_PI));
+
+    Reprojector reprojector;
+    size_t worstBadPixels = 0, fullRedraws = 0;
+    double worstPsnr = INFINITY;
+    bool passed = true;
+    for(unsigned int frame = 0; frame < reprojector.getRefreshInterval(); frame++) {
+        Camera camera(pos.x, pos.y, pos.z - WALK_STEP * frame, pitch, yaw, 0, start.getFovD(), start.getNear(), start.getFar());
+        arena.reset();
+        renderReprojected(camera, reprojector, triangles, IMAGE_WIDTH, IMAGE_HEIGHT, imageArr, depthBuffer, arena);
+        fullRedraws += reprojector.wasFullRedraw();
+        arena.reset();
+        renderImage(camera, triangles, IMAGE_WIDTH, IMAGE_HEIGHT, expectedArr, depthBuffer, arena);
+
+        rgbImage expected = toRgb(expectedArr, IMAGE_WIDTH, IMAGE_HEIGHT), actual = toRgb(imageArr, IMAGE_WIDTH, IMAGE_HEIGHT);
+        rgbImage diff;
+        size_t badPixels;
+        double psnr;
+        bool match = compareImages(expected, actual, opts, diff, badPixels, psnr);
+        worstBadPixels = std::max(worstBadPixels, badPixels);
+        worstPsnr = std::min(worstPsnr, psnr);
+        if(match) continue;
+
+        passed = false;
+        std::printf("%s_walk_%u %s: FAILED, %zu bad pixels, PSNR %.2f dB, %zu of %zu tiles redrawn\n", opts.scene.c_str(),
+                    frame, isaName, badPixels, psnr, reprojector.getDirtyTiles(), reprojector.getTileCount());
+        std::filesystem::create_directories(opts.outputDir);
+        std::string prefix = opts.outputDir + "/" + opts.scene + "_walk_" + std::to_string(frame) + "_" + isaName;
+        writePpm(prefix + "_actual.ppm", actual);
+        writePpm(prefix + "_diff.ppm", diff);
+    }
+    std::printf("%s_walk %s: %s, %u frames, %zu redrawn in full, worst %zu bad pixels, worst PSNR %.2f dB\n",
+                opts.scene.c_str(), isaName, passed ? "ok" : "FAILED", reprojector.getRefreshInterval(), fullRedraws,
+                worstBadPixels, worstPsnr);
+    return passed;
+}
+
+}
+
+int main(int argc, char** argv) {
+    options opts;
+    if(!parseOptions(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: goldenTest --scene NAME --golden-dir DIR [--media-dir DIR] [--output-dir DIR]\n"
+                             "                  [--update | --walk | [--reproject] [--compact]] [--channel-tolerance N]\n"
+                             "                  [--max-bad-pixels PERCENT]"
+                             " [--min-psnr DB]\n");
+        return 2;
+    }
+
+    std::vector<worldTriangle> triangles;
+    if(!buildScene(opts, triangles)) {
+        std::fprintf(stderr, "unknown or empty scene '%s'\n", opts.scene.c_str());
+        return 2;
+    }
+
+    std::vector<Camera> poses = goldenPoses();
+    bool passed = true;
+    compactMesh mesh;
+    if(opts.compact) {
+        buildCompactMesh(triangles, mesh);
+        compactError error = measureCompactError(triangles, mesh);
+        bool withinBound = error.positionMeasured <= error.positionBound;
+        std::printf("%s: compact mesh, %zu bytes per triangle instead of %zu\n", opts.scene.c_str(),
+                    sizeof(compactTriangle), sizeof(worldTriangle));
+        std::printf("  position error %g, bound %g%s\n", error.positionMeasured, error.positionBound,
+                    withinBound ? "" : ", FAILED");
+        std::printf("  normal error %g degrees, up to %g pixels on screen at the near plane\n", error.normalDegrees,
+                    screenErrorBound(error, poses[0], IMAGE_WIDTH, IMAGE_HEIGHT, poses[0].getNear()));
+        passed &= withinBound;
+    }
+
+    AlignedBuffer<colorARGB> imageArr(IMAGE_WIDTH * IMAGE_HEIGHT);
+    AlignedBuffer<float> depthBuffer(IMAGE_WIDTH * IMAGE_HEIGHT);
+    FrameArena arena;
+
+    std::vector<kernelIsa> isas;
+    for(kernelIsa isa : {kernelIsa::scalar, kernelIsa::sse41, kernelIsa::avx2, kernelIsa::avx512}) {
+        if(isaSupported(isa)) isas.push_back(isa);
+    }
+    if(opts.update) isas = {kernelIsa::scalar}; // References come from the scalar path
+
+    if(opts.walk) {
+        for(kernelIsa isa : isas) {
+            forceKernelIsa(isa);
+            passed &= walkForward(poses[0], triangles, opts, getKernels().name, imageArr, depthBuffer, arena);
+        }
+        return passed ? 0 : 1;
+    }
+
+    for(size_t pose = 0; pose < poses.size(); pose++) {
+        std::string imageName = opts.scene + "_" + std::to_string(pose);
+        std::string referencePath = opts.goldenDir + "/" + imageName + ".ppm";
+
+        rgbImage reference;
+        if(!opts.update && !readPpm(referencePath, reference)) {
+            std::printf("%s: missing reference %s\n", imageName.c_str(), referencePath.c_str());
+            passed = false;
+            continue;
+        }
+
+        for(kernelIsa isa : isas) {
+            forceKernelIsa(isa);
+            const char* isaName = getKernels().name;
+
+            if(opts.reproject) {
+                size_t dirtyTiles, tileCount;
+                bool reprojected = opts.compact ?
+                    renderReprojectedPose(poses[pose], mesh, imageArr, depthBuffer, arena, dirtyTiles, tileCount) :
+                    renderReprojectedPose(poses[pose], triangles, imageArr, depthBuffer, arena, dirtyTiles, tileCount);
+                if(reprojected) {
+                    std::printf("%s %s: reprojected, %zu of %zu tiles redrawn\n", imageName.c_str(), isaName, dirtyTiles, tileCount);
+                } else {
+                    std::printf("%s %s: FAILED, redrawn in full\n", imageName.c_str(), isaName);
+                    passed = false;
+                }
+            } else {
+                arena.reset();
+                Camera camera = poses[pose];
+                if(opts.compact) renderCompactImage(camera, mesh, IMAGE_WIDTH, IMAGE_HEIGHT, imageArr, depthBuffer, arena);
+                else renderImage(camera, triangles, IMAGE_WIDTH, IMAGE_HEIGHT, imageArr, depthBuffer, arena);
+            }
+            rgbImage actual = toRgb(imageArr, IMAGE_WIDTH, IMAGE_HEIGHT);
+
+            if(opts.update) {
+                bool written = writePpm(referencePath, actual);
+                std::printf("%s: %s %s\n", imageName.c_str(), written ? "wrote" : "failed to write", referencePath.c_str());
+                passed &= written;
+                continue;
+            }
+
+            if(actual.width != reference.width || actual.height != reference.height) {
+                std::printf("%s %s: reference is %zux%zu, expected %zux%zu\n", imageName.c_str(), isaName,
+                            reference.width, reference.height, actual.width, actual.height);
+                passed = false;
+                continue;
+            }
+
+            rgbImage diff;
+            size_t badPixels;
+            double psnr;
+            bool match = compareImages(reference, actual, opts, diff, badPixels, psnr);
+            std::printf("%s %s: %s, %zu bad pixels, PSNR %.2f dB\n", imageName.c_str(), isaName,
+                        match ? "ok" : "FAILED", badPixels, psnr);
+            if(match) continue;
+
+            passed = false;
+            std::filesystem::create_directories(opts.outputDir);
+            std::string prefix = opts.outputDir + "/" + imageName + "_" + isaName;
+            writePpm(prefix + "_actual.ppm", actual);
+            writePpm(prefix + "_diff.ppm", diff);
+            std::printf("  wrote %s_actual.ppm and %s_diff.ppm\n", prefix.c_str(), prefix.c_str());
+        }
+    }
+
+    return passed ? 0 : 1;
+}
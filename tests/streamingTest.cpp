@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chunkCache.hpp"
+#include "frameArena.hpp"
+#include "meshChunks.hpp"
+#include "readObj.hpp"
+#include "screenRender.hpp"
+
+// Checks the chunked mesh format and streaming renderer against the sample
+// model loaded whole.
+//
+// streamingTest [--media-dir DIR] [--output-dir DIR]
+//
+// Converts the model with a small chunk budget, checks the chunk table holds
+// every triangle once, and that streamed frames match renderImage once their
+// chunks have loaded, including under memory caps that force evictions and
+// skip chunks that cannot fit. Corrupt and truncated files must be rejected.
+// Converted files are written to the output directory.
+
+namespace {
+
+constexpr size_t IMAGE_WIDTH = 320;
+constexpr size_t IMAGE_HEIGHT = 240;
+constexpr uint32_t MAX_CHUNK_TRIANGLES = 16;
+constexpr int MAX_FRAMES = 1000; // Frames to wait for chunks to load before failing
+constexpr int SETTLED_FRAMES = 20; // Frames, 5 ms apart, without change before the cache counts as settled
+
+using triangleKey = std::array<float, 9>;
+
+struct streamContext {
+    AlignedBuffer<colorARGB> imageArr {IMAGE_WIDTH * IMAGE_HEIGHT};
+    AlignedBuffer<colorARGB> expected {IMAGE_WIDTH * IMAGE_HEIGHT};
+    AlignedBuffer<float> depthBuffer {IMAGE_WIDTH * IMAGE_HEIGHT};
+    FrameArena arena;
+};
+
+triangleKey keyOf(const worldTriangle &triangle) {
+    point4D a = triangle.getAPos(), b = triangle.getBPos(), c = triangle.getCPos();
+    return {a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z};
+}
+
+bool check(bool condition, const char* what) {
+    std::printf("%s: %s\n", what, condition ? "ok" : "FAILED");
+    return condition;
+}
+
+size_t countDifferentPixels(const AlignedBuffer<colorARGB> &a, const AlignedBuffer<colorARGB> &b) {
+    size_t different = 0;
+    for(size_t i = 0; i < IMAGE_WIDTH * IMAGE_HEIGHT; i++) different += a[i] != b[i];
+    return different;
+}
+
+// Render frames from camera until the resident bytes have not changed for
+// SETTLED_FRAMES frames, returns false if the cap was ever exceeded
+bool streamUntilSettled(Camera camera, ChunkCache &cache, size_t memoryCap, streamContext &context) {
+    size_t lastResident = SIZE_MAX;
+    int unchanged = 0;
+    for(int frame = 0; frame < MAX_FRAMES && unchanged < SETTLED_FRAMES; frame++) {
+        context.arena.reset();
+        renderStreamed(camera, cache, IMAGE_WIDTH, IMAGE_HEIGHT, context.imageArr, context.depthBuffer, context.arena);
+        if(cache.getResidentBytes() > memoryCap) return false;
+        unchanged = cache.getResidentBytes() == lastResident ? unchanged + 1 : 0;
+        lastResident = cache.getResidentBytes();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // One more frame so everything that arrived is drawn
+    context.arena.reset();
+    renderStreamed(camera, cache, IMAGE_WIDTH, IMAGE_HEIGHT, context.imageArr, context.depthBuffer, context.arena);
+    return cache.getResidentBytes() <= memoryCap;
+}
+
+// Streamed frame from camera matches renderImage once settled
+bool streamMatches(Camera camera, ChunkCache &cache, size_t memoryCap, std::vector<worldTriangle> &triangles,
+                   streamContext &context) {
+    if(!streamUntilSettled(camera, cache, memoryCap, context)) return false;
+    context.arena.reset();
+    renderImage(camera, triangles, IMAGE_WIDTH, IMAGE_HEIGHT, context.expected, context.depthBuffer, context.arena);
+    return countDifferentPixels(context.imageArr, context.expected) == 0;
+}
+
+// Resident bytes once the chunks camera needs have loaded into a cache with no cap
+size_t viewBytes(const std::string &name, Camera camera, streamContext &context) {
+    ChunkCache cache(name, SIZE_MAX);
+    streamUntilSettled(camera, cache, SIZE_MAX, context);
+    return cache.getResidentBytes();
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string mediaDir = "media";
+    std::string outputDir = "streamingOutput";
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--media-dir") == 0 && i + 1 < argc) {
+            mediaDir = argv[++i];
+        } else if(std::strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: streamingTest [--media-dir DIR] [--output-dir DIR]\n");
+            return 2;
+        }
+    }
+
+    std::vector<worldTriangle> triangles;
+    objToTriangles(mediaDir + "/model", triangles);
+    if(triangles.empty()) {
+        std::fprintf(stderr, "could not load %s/model.obj\n", mediaDir.c_str());
+        return 2;
+    }
+
+    std::filesystem::create_directories(outputDir);
+    std::string name = outputDir + "/model";
+    std::filesystem::copy_file(mediaDir + "/model.obj", name + ".obj", std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::remove(name + ".chunks");
+
+    bool passed = true;
+    passed &= check(!objToChunks(outputDir + "/missing"), "converting a missing model fails");
+    passed &= check(objToChunks(name, MAX_CHUNK_TRIANGLES), "convert");
+    passed &= check(!std::filesystem::exists(name + ".chunks.tmp"), "temporary file renamed");
+
+    // Every triangle is in exactly one chunk, within that chunk's bounds
+    std::ifstream file(name + ".chunks", std::ios::binary);
+    chunkFileHeader header;
+    std::vector<chunkInfo> chunks;
+    if(!check(readChunkTable(file, header, chunks), "read chunk table")) return 1;
+
+    std::vector<triangleKey> expectedKeys, chunkKeys;
+    for(const worldTriangle &triangle : triangles) expectedKeys.push_back(keyOf(triangle));
+    bool withinBudget = true, withinBounds = true, readAll = true;
+    size_t totalBytes = 0, largestChunkBytes = 0;
+    for(const chunkInfo &chunk : chunks) {
+        std::vector<worldTriangle> chunkTriangles;
+        readAll &= readChunkTriangles(file, chunk, chunkTriangles);
+        withinBudget &= chunk.triangleCount <= MAX_CHUNK_TRIANGLES;
+        for(const worldTriangle &triangle : chunkTriangles) {
+            triangleKey key = keyOf(triangle);
+            for(size_t i = 0; i < key.size(); i++) {
+                withinBounds &= key[i] >= chunk.boundsMin[i % 3] && key[i] <= chunk.boundsMax[i % 3];
+            }
+            chunkKeys.push_back(key);
+        }
+        totalBytes += chunk.triangleCount * sizeof(worldTriangle);
+        largestChunkBytes = std::max(largestChunkBytes, chunk.triangleCount * sizeof(worldTriangle));
+    }
+    std::sort(expectedKeys.begin(), expectedKeys.end());
+    std::sort(chunkKeys.begin(), chunkKeys.end());
+    std::printf("%zu triangles in %zu chunks\n", chunkKeys.size(), chunks.size());
+    passed &= check(readAll, "read every chunk");
+    passed &= check(chunkKeys == expectedKeys, "chunks hold every triangle once");
+    passed &= check(withinBudget, "chunks within the triangle budget");
+    passed &= check(withinBounds, "triangles within their chunk's bounds");
+    file.close();
+
+    streamContext context;
+    Camera whole(0, 0, 5, 0, 180, 0, 80, 0.5, 100); // Sees the whole model
+    Camera left(-1.5f, 0, 2.5f, 0, 180, 0, 30, 0.5, 100); // Close up on each side
+    Camera right(1.5f, 0, 2.5f, 0, 180, 0, 30, 0.5, 100);
+
+    {
+        ChunkCache cache(name, SIZE_MAX);
+        passed &= check(cache.isOpen() && cache.getChunkCount() == chunks.size(), "open cache");
+        passed &= check(streamMatches(whole, cache, SIZE_MAX, triangles, context), "streamed frame matches renderImage");
+        passed &= check(cache.getResidentBytes() == totalBytes, "every chunk resident");
+    }
+
+    // A cap that fits either side's chunks but not both, so moving from one
+    // side to the other must evict
+    size_t leftBytes = viewBytes(name, left, context), rightBytes = viewBytes(name, right, context);
+    size_t sideCap = std::max(leftBytes, rightBytes);
+    bool sidesDiffer = leftBytes + rightBytes > sideCap && sideCap < totalBytes;
+    passed &= check(sidesDiffer, "sides need different chunks");
+    {
+        ChunkCache cache(name, sideCap);
+        passed &= check(streamMatches(left, cache, sideCap, triangles, context), "left side under a tight cap");
+        passed &= check(streamMatches(right, cache, sideCap, triangles, context), "right side after evicting the left");
+    }
+
+    // A cap smaller than the largest chunk, smaller chunks must still load
+    {
+        size_t tinyCap = largestChunkBytes - 1;
+        ChunkCache cache(name, tinyCap);
+        passed &= check(streamUntilSettled(whole, cache, tinyCap, context), "resident bytes within a cap below one chunk");
+        passed &= check(cache.getResidentBytes() > 0, "chunks smaller than the cap load");
+    }
+
+    // A header claiming more chunks than the file holds, and a file cut short
+    std::string corruptName = outputDir + "/corrupt";
+    std::filesystem::copy_file(name + ".chunks", corruptName + ".chunks", std::filesystem::copy_options::overwrite_existing);
+    {
+        std::fstream corrupt(corruptName + ".chunks", std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t chunkCount = 0xFFFFFFF0;
+        corrupt.seekp(offsetof(chunkFileHeader, chunkCount));
+        corrupt.write(reinterpret_cast<const char*> (&chunkCount), sizeof(chunkCount));
+    }
+    passed &= check(!ChunkCache(corruptName, SIZE_MAX).isOpen(), "corrupt chunk count rejected");
+
+    std::filesystem::copy_file(name + ".chunks", corruptName + ".chunks", std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(corruptName + ".chunks", std::filesystem::file_size(corruptName + ".chunks") - 1);
+    passed &= check(!ChunkCache(corruptName, SIZE_MAX).isOpen(), "truncated file rejected");
+
+    return passed ? 0 : 1;
+}